@@ -98,6 +98,21 @@ std::ostream &operator<<(std::ostream &os, const NeedsAlloc &v)
 }
 
 
+//
+// A structure that is three machine words in size and owns a heap allocation
+//
+struct SmallVector
+{
+    explicit SmallVector(int i) : v(4, i) {}
+    std::vector<int> v;
+};
+
+std::ostream &operator<<(std::ostream &os, const SmallVector &v)
+{
+    return os << v.v[0];
+}
+
+
 //
 // A structure with an initializer list constructor
 //
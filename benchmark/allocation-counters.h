@@ -0,0 +1,135 @@
+//
+// allocation-counters.h
+//
+// Counting replacements for global operator new and delete, for benchmarks.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef ALLOCATION_COUNTERS
+#define ALLOCATION_COUNTERS 1
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include <stdlib.h>
+
+#include <benchmark/benchmark.h>
+
+//
+// Include this header in one file of each benchmark binary. It replaces the global
+// operator new and delete with versions that count the allocations each thread makes
+// and the bytes it asks for, and AllocationCounters reports the counts made while it's
+// alive as allocations and bytes per iteration. Make one right before the benchmark
+// loop, so setup isn't counted:
+//
+//     AllocationCounters allocations(state);
+//     for (auto _ : state) { ... }
+//
+// The counts are per thread, so multi-threaded benchmarks report the work of the
+// threads that run them, and not of helper threads they start.
+//
+struct AllocationCount
+{
+    uint64_t allocations;
+    uint64_t bytes;
+};
+
+inline thread_local AllocationCount allocation_count = { 0, 0 };
+
+class AllocationCounters
+{
+public:
+    explicit AllocationCounters(benchmark::State &state) : state(state), start(allocation_count) {}
+
+    // Read the counts before adding the counters, which allocates.
+    ~AllocationCounters() {
+        AllocationCount end = allocation_count;
+        state.counters["allocs/iter"] = benchmark::Counter(end.allocations - start.allocations,
+            benchmark::Counter::kAvgIterations);
+        state.counters["bytes/iter"] = benchmark::Counter(end.bytes - start.bytes,
+            benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State &state;
+    AllocationCount start;
+};
+
+static void *counted_allocate(size_t size) {
+    allocation_count.allocations++;
+    allocation_count.bytes += size;
+    return malloc(size == 0 ? 1 : size);
+}
+
+static void *counted_allocate(size_t size, size_t alignment) {
+    allocation_count.allocations++;
+    allocation_count.bytes += size;
+    void *p = nullptr;
+    if (posix_memalign(&p, alignment < sizeof(void *) ? sizeof(void *) : alignment, size == 0 ? 1 : size) != 0) {
+        return nullptr;
+    }
+    return p;
+}
+
+void *operator new(size_t size) {
+    if (void *p = counted_allocate(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return counted_allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return counted_allocate(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    if (void *p = counted_allocate(size, static_cast<size_t>(alignment))) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { free(p); }
+
+#endif  // ALLOCATION_COUNTERS
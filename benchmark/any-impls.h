@@ -0,0 +1,95 @@
+//
+// any-impls.h
+//
+// Adapters that let one templated benchmark run over each Any implementation.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef ANY_IMPLS
+#define ANY_IMPLS 1
+
+#include <any>
+
+#include <xllvm-any.h>
+#include <xgcc-any.h>
+#include <cyto-any.h>
+
+//
+// Each adapter names an Any class, and forwards any_cast to the namespace it lives in,
+// since the four any_cast functions can't be found by one unqualified call. The rest of
+// the interface is the same member functions in all four, and swap() is found by
+// argument-dependent lookup. A benchmark is a function template over an adapter, and is
+// registered once per implementation:
+//
+//     template <class I>
+//     static void any_test(benchmark::State &state) {
+//         using A = typename I::Any;
+//         ...
+//         int v = I::template any_cast<int>(a);
+//     }
+//
+//     BENCHMARK_TEMPLATE(any_test, StdAnyImpl);
+//     BENCHMARK_TEMPLATE(any_test, XLLVMAnyImpl);
+//     BENCHMARK_TEMPLATE(any_test, XGCCAnyImpl);
+//     BENCHMARK_TEMPLATE(any_test, CytoAnyImpl);
+//
+// Adding an implementation means adding an adapter here, and a line per benchmark.
+//
+struct StdAnyImpl
+{
+    using Any = std::any;
+
+    template <class V> static V any_cast(const Any &a) { return std::any_cast<V>(a); }
+    template <class V> static const V *any_cast(const Any *a) noexcept { return std::any_cast<V>(a); }
+    template <class V> static V *any_cast(Any *a) noexcept { return std::any_cast<V>(a); }
+};
+
+struct XLLVMAnyImpl
+{
+    using Any = XLLVM::Any;
+
+    template <class V> static V any_cast(const Any &a) { return XLLVM::any_cast<V>(a); }
+    template <class V> static const V *any_cast(const Any *a) noexcept { return XLLVM::any_cast<V>(a); }
+    template <class V> static V *any_cast(Any *a) noexcept { return XLLVM::any_cast<V>(a); }
+};
+
+struct XGCCAnyImpl
+{
+    using Any = XGCC::Any;
+
+    template <class V> static V any_cast(const Any &a) { return XGCC::any_cast<V>(a); }
+    template <class V> static const V *any_cast(const Any *a) noexcept { return XGCC::any_cast<V>(a); }
+    template <class V> static V *any_cast(Any *a) noexcept { return XGCC::any_cast<V>(a); }
+};
+
+struct CytoAnyImpl
+{
+    using Any = Cyto::Any;
+
+    template <class V> static V any_cast(const Any &a) { return Cyto::any_cast<V>(a); }
+    template <class V> static const V *any_cast(const Any *a) noexcept { return Cyto::any_cast<V>(a); }
+    template <class V> static V *any_cast(Any *a) noexcept { return Cyto::any_cast<V>(a); }
+};
+
+#endif  // ANY_IMPLS
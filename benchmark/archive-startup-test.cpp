@@ -0,0 +1,182 @@
+//
+// archive-startup-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <iostream>
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any-types.h>
+#include <cyto-any-archive.h>
+
+namespace Cyto {
+
+template <>
+struct AnyCodec<std::string>
+{
+    static constexpr const char *name = "std::string";
+
+    static void encode(AnyWriter &w, const std::string &s) {
+        w.write(uint32_t(s.size()));
+        w.write(s.data(), s.size());
+    }
+
+    static std::string decode(AnyReader &r) {
+        std::string s(r.read<uint32_t>(), '\0');
+        r.read(s.data(), s.size());
+        return s;
+    }
+};
+
+}  // namespace Cyto
+
+//
+// Start up with a lookup table of int, double, Trivial, and std::string values of the
+// size given by the benchmark argument, and read 64 values from it, first by reading
+// a file of serialized values into a vector of Any, and then by opening the table as
+// a memory-mapped Cyto::AnyArchive, which only touches the values that are read.
+//
+static constexpr const char *StreamPath = "/tmp/archive-startup-test.bin";
+static constexpr const char *ArchivePath = "/tmp/archive-startup-test.arc";
+static constexpr int ReadCount = 64;
+
+using A = Cyto::Any;
+
+static void write_table(int count)
+{
+    std::vector<A> v;
+    v.reserve(count);
+    for (int i = 0; i < count; i++) {
+        switch (i % 4) {
+            case 0:
+                v.emplace_back(i);
+                break;
+            case 1:
+                v.emplace_back(i * 0.5);
+                break;
+            case 2:
+                v.emplace_back(Trivial(i));
+                break;
+            default:
+                v.emplace_back(std::string(i % 32, 'x'));
+                break;
+        }
+    }
+    Cyto::write_any_archive(ArchivePath, v.data(), v.size());
+    std::vector<unsigned char> bytes;
+    {
+        Cyto::AnyWriter w(bytes);
+        for (const A &a : v) {
+            Cyto::serialize(w, a);
+        }
+    }
+    FILE *file = fopen(StreamPath, "wb");
+    fwrite(bytes.data(), 1, bytes.size(), file);
+    fclose(file);
+}
+
+static double key(const A &a)
+{
+    if (const int *p = Cyto::any_cast<int>(&a)) {
+        return *p;
+    }
+    if (const double *p = Cyto::any_cast<double>(&a)) {
+        return *p;
+    }
+    if (const Trivial *p = Cyto::any_cast<Trivial>(&a)) {
+        return p->i;
+    }
+    if (const std::string *p = Cyto::any_cast<std::string>(&a)) {
+        return p->size();
+    }
+    return 0;
+}
+
+static double key(const Cyto::AnyView<A> &v)
+{
+    if (const int *p = Cyto::any_cast<int>(&v)) {
+        return *p;
+    }
+    if (const double *p = Cyto::any_cast<double>(&v)) {
+        return *p;
+    }
+    if (const Trivial *p = Cyto::any_cast<Trivial>(&v)) {
+        return p->i;
+    }
+    if (const std::string *p = Cyto::any_cast<std::string>(&v)) {
+        return p->size();
+    }
+    return 0;
+}
+
+static void vector_startup_test(benchmark::State &state)
+{
+    int count = state.range(0);
+    write_table(count);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        FILE *file = fopen(StreamPath, "rb");
+        fseek(file, 0, SEEK_END);
+        std::vector<unsigned char> bytes(ftell(file));
+        fseek(file, 0, SEEK_SET);
+        benchmark::DoNotOptimize(fread(bytes.data(), 1, bytes.size(), file));
+        fclose(file);
+        std::vector<A> table(count);
+        Cyto::AnyReader r(bytes.data(), bytes.size());
+        for (A &a : table) {
+            Cyto::deserialize(r, a);
+        }
+        double sum = 0;
+        for (int i = 0; i < ReadCount; i++) {
+            sum += key(table[(i * 7919) % count]);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+static void archive_startup_test(benchmark::State &state)
+{
+    int count = state.range(0);
+    write_table(count);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        Cyto::AnyArchive archive(ArchivePath);
+        double sum = 0;
+        for (int i = 0; i < ReadCount; i++) {
+            sum += key(archive[(i * 7919) % count]);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+BENCHMARK(vector_startup_test)->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 18);
+BENCHMARK(archive_startup_test)->Arg(1 << 10)->Arg(1 << 14)->Arg(1 << 18);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,113 @@
+//
+// atomic-config-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any>
+
+#include <any-types.h>
+#include <cyto-any.h>
+#include <cyto-atomic-any.h>
+
+//
+// Readers fetch a configuration value on every request while the first thread also
+// reloads it every ReloadInterval requests. The baseline guards a Cyto::Any with a
+// mutex and copies it out. Cyto::AtomicAny copies it out with load(), or reads it in
+// place with read(), without taking a lock.
+//
+static constexpr int ReloadInterval = 1024;
+
+static Cyto::Any make_config(int i)
+{
+    return Cyto::Any(std::string(48, char('a' + i % 26)));
+}
+
+static size_t config_size(const Cyto::Any &a)
+{
+    return Cyto::any_cast<std::string>(&a)->size();
+}
+
+static void mutex_any_test(benchmark::State &state)
+{
+    static std::mutex lock;
+    static Cyto::Any config = make_config(0);
+    int i = 0;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        if (state.thread_index() == 0 && ++i % ReloadInterval == 0) {
+            Cyto::Any fresh = make_config(i);
+            std::lock_guard<std::mutex> guard(lock);
+            config = std::move(fresh);
+        }
+        Cyto::Any copy;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            copy = config;
+        }
+        benchmark::DoNotOptimize(config_size(copy));
+    }
+}
+
+static void atomic_any_load_test(benchmark::State &state)
+{
+    static Cyto::AtomicAny config(make_config(0));
+    int i = 0;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        if (state.thread_index() == 0 && ++i % ReloadInterval == 0) {
+            config.store(make_config(i));
+        }
+        Cyto::Any copy = config.load();
+        benchmark::DoNotOptimize(config_size(copy));
+    }
+}
+
+static void atomic_any_read_test(benchmark::State &state)
+{
+    static Cyto::AtomicAny config(make_config(0));
+    int i = 0;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        if (state.thread_index() == 0 && ++i % ReloadInterval == 0) {
+            config.store(make_config(i));
+        }
+        benchmark::DoNotOptimize(config.read(config_size));
+    }
+}
+
+BENCHMARK(mutex_any_test)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(atomic_any_load_test)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(atomic_any_read_test)->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
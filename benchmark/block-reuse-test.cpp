@@ -0,0 +1,84 @@
+//
+// block-reuse-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any>
+
+#include <any-types.h>
+#include <cyto-any.h>
+
+//
+// A table of long-lived Any slots, each of which flips between two large types of
+// the same size, NeedsAlloc and a pair of strings, on every update. Cyto::Any makes
+// each new value in the heap block of the old one.
+//
+static constexpr int SlotCount = 64;
+
+using StringPair = std::pair<std::string, std::string>;
+
+template <class A>
+static void flip_test(benchmark::State &state)
+{
+    std::vector<A> slots(SlotCount);
+    int i = 0;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        for (A &slot : slots) {
+            if (i & 1) {
+                slot = NeedsAlloc(i);
+            }
+            else {
+                slot = StringPair();
+            }
+        }
+        i++;
+        benchmark::DoNotOptimize(slots.data());
+    }
+}
+
+static void std_any_test(benchmark::State &state)
+{
+    flip_test<std::any>(state);
+}
+
+static void cyto_any_test(benchmark::State &state)
+{
+    flip_test<Cyto::Any>(state);
+}
+
+BENCHMARK(std_any_test);
+BENCHMARK(cyto_any_test);
+
+BENCHMARK_MAIN();
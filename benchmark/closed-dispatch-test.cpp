@@ -0,0 +1,151 @@
+//
+// closed-dispatch-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any>
+
+#include <any-types.h>
+#include <cyto-any.h>
+#include <cyto-closed-any.h>
+
+//
+// Copy a vector of Any instances holding a mix of small trivial values (int), small
+// non-trivial values (NonTrivial), and large values (NeedsAlloc), and then sum a key
+// from each one. Every copy and destroy is a call through the actions table for
+// Cyto::Any, and a switch on a type index that the compiler can see for ClosedAny.
+//
+static constexpr int ValueCount = 1024;
+
+using Closed = Cyto::ClosedAny<int, NonTrivial, NeedsAlloc>;
+
+template <class A>
+static std::vector<A> make_values()
+{
+    std::vector<A> v;
+    v.reserve(ValueCount);
+    for (int i = 0; i < ValueCount; i++) {
+        switch (i % 3) {
+            case 0:
+                v.emplace_back(i);
+                break;
+            case 1:
+                v.emplace_back(NonTrivial(i));
+                break;
+            default:
+                v.emplace_back(NeedsAlloc(i));
+                break;
+        }
+    }
+    return v;
+}
+
+template <class A>
+static long sum_keys(const std::vector<A> &v)
+{
+    using std::any_cast;
+    using Cyto::any_cast;
+    long sum = 0;
+    for (const A &a : v) {
+        if (const int *p = any_cast<int>(&a)) {
+            sum += *p;
+        }
+        else if (const NonTrivial *p = any_cast<NonTrivial>(&a)) {
+            sum += p->i;
+        }
+        else if (const NeedsAlloc *p = any_cast<NeedsAlloc>(&a)) {
+            sum += p->n1.i;
+        }
+    }
+    return sum;
+}
+
+template <class A>
+static void copy_test(benchmark::State &state)
+{
+    std::vector<A> values = make_values<A>();
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        std::vector<A> copy(values);
+        benchmark::DoNotOptimize(copy.data());
+    }
+}
+
+template <class A>
+static void cast_test(benchmark::State &state)
+{
+    std::vector<A> values = make_values<A>();
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sum_keys(values));
+    }
+}
+
+static void std_any_copy_test(benchmark::State &state)
+{
+    copy_test<std::any>(state);
+}
+
+static void cyto_any_copy_test(benchmark::State &state)
+{
+    copy_test<Cyto::Any>(state);
+}
+
+static void cyto_closed_any_copy_test(benchmark::State &state)
+{
+    copy_test<Closed>(state);
+}
+
+static void std_any_cast_test(benchmark::State &state)
+{
+    cast_test<std::any>(state);
+}
+
+static void cyto_any_cast_test(benchmark::State &state)
+{
+    cast_test<Cyto::Any>(state);
+}
+
+static void cyto_closed_any_cast_test(benchmark::State &state)
+{
+    cast_test<Closed>(state);
+}
+
+BENCHMARK(std_any_copy_test);
+BENCHMARK(cyto_any_copy_test);
+BENCHMARK(cyto_closed_any_copy_test);
+BENCHMARK(std_any_cast_test);
+BENCHMARK(cyto_any_cast_test);
+BENCHMARK(cyto_closed_any_cast_test);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,207 @@
+//
+// codec-stream-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <iostream>
+
+#define ANY_USE_CODEC 1
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any-types.h>
+#include <cyto-any.h>
+
+namespace Cyto {
+
+template <>
+struct AnyCodec<std::string>
+{
+    static constexpr const char *name = "std::string";
+
+    static void encode(AnyWriter &w, const std::string &s) {
+        w.write(uint32_t(s.size()));
+        w.write(s.data(), s.size());
+    }
+
+    static std::string decode(AnyReader &r) {
+        std::string s(r.read<uint32_t>(), '\0');
+        r.read(s.data(), s.size());
+        return s;
+    }
+};
+
+}  // namespace Cyto
+
+//
+// Write a vector of Any instances holding int, double, Trivial, and std::string to a
+// byte buffer, and read it back, first with a hand-written chain of any_cast calls
+// that probes each value for its type and writes a type index in front of it, and
+// then with Cyto::serialize() and Cyto::deserialize(), which make one call through
+// the codec actions of each value.
+//
+static constexpr int ValueCount = 1024;
+
+using A = Cyto::Any;
+
+static std::vector<A> make_values()
+{
+    std::vector<A> v;
+    v.reserve(ValueCount);
+    for (int i = 0; i < ValueCount; i++) {
+        switch (i % 4) {
+            case 0:
+                v.emplace_back(i);
+                break;
+            case 1:
+                v.emplace_back(i * 0.5);
+                break;
+            case 2:
+                v.emplace_back(Trivial(i));
+                break;
+            default:
+                v.emplace_back(std::string(i % 16, 'x'));
+                break;
+        }
+    }
+    return v;
+}
+
+static void probe_write(Cyto::AnyWriter &w, const A &a)
+{
+    if (const int *p = Cyto::any_cast<int>(&a)) {
+        w.write(uint8_t(0));
+        w.write(*p);
+    }
+    else if (const double *p = Cyto::any_cast<double>(&a)) {
+        w.write(uint8_t(1));
+        w.write(*p);
+    }
+    else if (const Trivial *p = Cyto::any_cast<Trivial>(&a)) {
+        w.write(uint8_t(2));
+        w.write(*p);
+    }
+    else if (const std::string *p = Cyto::any_cast<std::string>(&a)) {
+        w.write(uint8_t(3));
+        Cyto::AnyCodec<std::string>::encode(w, *p);
+    }
+}
+
+static void probe_read(Cyto::AnyReader &r, A &a)
+{
+    switch (r.read<uint8_t>()) {
+        case 0:
+            a = r.read<int>();
+            break;
+        case 1:
+            a = r.read<double>();
+            break;
+        case 2:
+            a = Trivial(r.read<int>());
+            break;
+        default:
+            a = Cyto::AnyCodec<std::string>::decode(r);
+            break;
+    }
+}
+
+static void probe_write_test(benchmark::State &state)
+{
+    std::vector<A> values = make_values();
+    std::vector<unsigned char> bytes;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        bytes.clear();
+        Cyto::AnyWriter w(bytes);
+        for (const A &a : values) {
+            probe_write(w, a);
+        }
+        benchmark::DoNotOptimize(bytes.data());
+    }
+}
+
+static void codec_write_test(benchmark::State &state)
+{
+    std::vector<A> values = make_values();
+    std::vector<unsigned char> bytes;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        bytes.clear();
+        Cyto::AnyWriter w(bytes);
+        for (const A &a : values) {
+            Cyto::serialize(w, a);
+        }
+        benchmark::DoNotOptimize(bytes.data());
+    }
+}
+
+static void probe_read_test(benchmark::State &state)
+{
+    std::vector<A> values = make_values();
+    std::vector<unsigned char> bytes;
+    Cyto::AnyWriter w(bytes);
+    for (const A &a : values) {
+        probe_write(w, a);
+    }
+    std::vector<A> result(ValueCount);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        Cyto::AnyReader r(bytes.data(), bytes.size());
+        for (A &a : result) {
+            probe_read(r, a);
+        }
+        benchmark::DoNotOptimize(result.data());
+    }
+}
+
+static void codec_read_test(benchmark::State &state)
+{
+    std::vector<A> values = make_values();
+    std::vector<unsigned char> bytes;
+    Cyto::AnyWriter w(bytes);
+    for (const A &a : values) {
+        Cyto::serialize(w, a);
+    }
+    std::vector<A> result(ValueCount);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        Cyto::AnyReader r(bytes.data(), bytes.size());
+        for (A &a : result) {
+            Cyto::deserialize(r, a);
+        }
+        benchmark::DoNotOptimize(result.data());
+    }
+}
+
+BENCHMARK(probe_write_test);
+BENCHMARK(codec_write_test);
+BENCHMARK(probe_read_test);
+BENCHMARK(codec_read_test);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,140 @@
+//
+// compact-column-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any>
+
+#include <any-types.h>
+#include <cyto-any.h>
+#include <cyto-compact-any.h>
+
+//
+// A column of a million int values, too big to stay in cache, which is scanned
+// and copied. The smaller each Any is, the less memory traffic this needs.
+//
+static constexpr int ColumnCount = 1 << 20;
+
+template <class A>
+static std::vector<A> make_column()
+{
+    std::vector<A> v;
+    v.reserve(ColumnCount);
+    for (int i = 0; i < ColumnCount; i++) {
+        v.emplace_back(i);
+    }
+    return v;
+}
+
+static void std_any_scan_test(benchmark::State &state)
+{
+    using A = std::any;
+    std::vector<A> column = make_column<A>();
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        long sum = 0;
+        for (const A &a : column) {
+            sum += *std::any_cast<int>(&a);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+static void std_any_copy_test(benchmark::State &state)
+{
+    using A = std::any;
+    std::vector<A> column = make_column<A>();
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        std::vector<A> copy(column);
+        benchmark::DoNotOptimize(copy.data());
+    }
+}
+
+static void cyto_any_scan_test(benchmark::State &state)
+{
+    using A = Cyto::Any;
+    std::vector<A> column = make_column<A>();
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        long sum = 0;
+        for (const A &a : column) {
+            sum += *Cyto::any_cast<int>(&a);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+static void cyto_any_copy_test(benchmark::State &state)
+{
+    using A = Cyto::Any;
+    std::vector<A> column = make_column<A>();
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        std::vector<A> copy(column);
+        benchmark::DoNotOptimize(copy.data());
+    }
+}
+
+static void cyto_compact_any_scan_test(benchmark::State &state)
+{
+    using A = Cyto::CompactAny;
+    std::vector<A> column = make_column<A>();
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        long sum = 0;
+        for (const A &a : column) {
+            sum += *Cyto::any_cast<int>(&a);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+static void cyto_compact_any_copy_test(benchmark::State &state)
+{
+    using A = Cyto::CompactAny;
+    std::vector<A> column = make_column<A>();
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        std::vector<A> copy(column);
+        benchmark::DoNotOptimize(copy.data());
+    }
+}
+
+BENCHMARK(std_any_scan_test)->Unit(benchmark::kMicrosecond);
+BENCHMARK(cyto_any_scan_test)->Unit(benchmark::kMicrosecond);
+BENCHMARK(cyto_compact_any_scan_test)->Unit(benchmark::kMicrosecond);
+BENCHMARK(std_any_copy_test)->Unit(benchmark::kMicrosecond);
+BENCHMARK(cyto_any_copy_test)->Unit(benchmark::kMicrosecond);
+BENCHMARK(cyto_compact_any_copy_test)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
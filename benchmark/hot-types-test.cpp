@@ -0,0 +1,123 @@
+//
+// hot-types-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any>
+
+#include <any-types.h>
+#include <cyto-any.h>
+
+//
+// Copy, move, and read a vector of Any instances in which the percentage of hot
+// values, int, double, and std::string, is given by the benchmark argument, and the
+// rest are cold values, NonTrivial, NonTrivialString, and NeedsAlloc. Cyto::HotAny
+// with the hot types runs their copies, moves, and drops inline, and makes calls
+// through the actions structure only for the cold ones.
+//
+static constexpr int ValueCount = 256;
+
+using Hot = Cyto::HotAny<int, double, std::string>;
+
+template <class A>
+static std::vector<A> make_values(int hot_percent)
+{
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::vector<A> v;
+    v.reserve(ValueCount);
+    for (int i = 0; i < ValueCount; i++) {
+        bool hot = percent(rng) < hot_percent;
+        switch (i % 3) {
+            case 0:
+                hot ? v.emplace_back(i) : v.emplace_back(NonTrivial(i));
+                break;
+            case 1:
+                hot ? v.emplace_back(i * 0.5) : v.emplace_back(NonTrivialString(std::string(i % 16, 'y')));
+                break;
+            default:
+                hot ? v.emplace_back(std::string(i % 16, 'x')) : v.emplace_back(NeedsAlloc(i));
+                break;
+        }
+    }
+    return v;
+}
+
+template <class A>
+static void mix_test(benchmark::State &state)
+{
+    using std::any_cast;
+    using Cyto::any_cast;
+    std::vector<A> values = make_values<A>(state.range(0));
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        std::vector<A> copy(values);
+        std::vector<A> moved;
+        moved.reserve(copy.size());
+        for (A &a : copy) {
+            moved.push_back(std::move(a));
+        }
+        long sum = 0;
+        for (const A &a : moved) {
+            if (const int *p = any_cast<int>(&a)) {
+                sum += *p;
+            }
+            else if (const std::string *p = any_cast<std::string>(&a)) {
+                sum += p->size();
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+static void std_any_test(benchmark::State &state)
+{
+    mix_test<std::any>(state);
+}
+
+static void cyto_any_test(benchmark::State &state)
+{
+    mix_test<Cyto::Any>(state);
+}
+
+static void cyto_hot_any_test(benchmark::State &state)
+{
+    mix_test<Hot>(state);
+}
+
+BENCHMARK(std_any_test)->Arg(0)->Arg(50)->Arg(90)->Arg(100);
+BENCHMARK(cyto_any_test)->Arg(0)->Arg(50)->Arg(90)->Arg(100);
+BENCHMARK(cyto_hot_any_test)->Arg(0)->Arg(50)->Arg(90)->Arg(100);
+
+BENCHMARK_MAIN();
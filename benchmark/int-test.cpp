@@ -30,88 +30,33 @@
 
 #include <benchmark/benchmark.h>
 
-#include <any>
+#include <allocation-counters.h>
 
+#include <any-impls.h>
 #include <any-types.h>
-#include <xllvm-any.h>
-#include <xgcc-any.h>
-#include <cyto-any.h>
 
-static void std_any_test(benchmark::State &state)
+template <class I>
+static void any_test(benchmark::State &state)
 {
-    using namespace std;
-    using A = std::any;
+    using A = typename I::Any;
     A r;
+    AllocationCounters allocations(state);
     for (auto _ : state) {
         int i = 0;
         benchmark::DoNotOptimize(i += 1);
         A a1 = i;    
         A a2(a1);    
         A a3 = a1;
-        int v2 = std::any_cast<int>(a3);
+        int v2 = I::template any_cast<int>(a3);
         r = v2;
     }
     int x;
-    benchmark::DoNotOptimize(x = std::any_cast<int>(r));
+    benchmark::DoNotOptimize(x = I::template any_cast<int>(r));
 }
 
-static void xllvm_any_test(benchmark::State &state)
-{
-    using namespace XLLVM;
-    using A = XLLVM::Any;
-    A r;
-    for (auto _ : state) {
-        int i = 0;
-        benchmark::DoNotOptimize(i += 1);
-        A a1 = i;    
-        A a2(a1);    
-        A a3 = a1;
-        int v2 = XLLVM::any_cast<int>(a3);
-        r = v2;
-    }
-    int x;
-    benchmark::DoNotOptimize(x = XLLVM::any_cast<int>(r));
-}
-
-static void xgcc_any_test(benchmark::State &state)
-{
-    using namespace XGCC;
-    using A = XGCC::Any;
-    A r;
-    for (auto _ : state) {
-        int i = 0;
-        benchmark::DoNotOptimize(i += 1);
-        A a1 = i;    
-        A a2(a1);    
-        A a3 = a1;
-        int v2 = XGCC::any_cast<int>(a3);
-        r = v2;
-    }
-    int x;
-    benchmark::DoNotOptimize(x = XGCC::any_cast<int>(r));
-}
-
-static void cyto_any_test(benchmark::State &state)
-{
-    using namespace Cyto;
-    using A = Cyto::Any;
-    A r;
-    for (auto _ : state) {
-        int i = 0;
-        benchmark::DoNotOptimize(i += 1);
-        A a1 = i;    
-        A a2(a1);    
-        A a3 = a1;
-        int v2 = Cyto::any_cast<int>(a3);
-        r = v2;
-    }
-    int x;
-    benchmark::DoNotOptimize(x = Cyto::any_cast<int>(r));
-}
-
-BENCHMARK(std_any_test)->Unit(benchmark::kNanosecond);
-BENCHMARK(xllvm_any_test)->Unit(benchmark::kNanosecond);
-BENCHMARK(xgcc_any_test)->Unit(benchmark::kNanosecond);
-BENCHMARK(cyto_any_test)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_test, StdAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_test, XLLVMAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_test, XGCCAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_test, CytoAnyImpl)->Unit(benchmark::kNanosecond);
 
 BENCHMARK_MAIN();
@@ -0,0 +1,105 @@
+//
+// lazy-slots-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <iostream>
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any-types.h>
+#include <cyto-lazy-any.h>
+
+//
+// Fill the 16 slots of a request context with NeedsAlloc values, and read the
+// percentage of them given by the benchmark argument, once with Cyto::Any, which
+// makes every value up front, and once with Cyto::LazyAny and Cyto::SyncLazyAny,
+// which only make the values that are read.
+//
+static constexpr int SlotCount = 16;
+static constexpr int RequestCount = 64;
+
+static std::vector<bool> make_reads(int read_percent)
+{
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::vector<bool> reads(SlotCount * RequestCount);
+    for (size_t i = 0; i < reads.size(); i++) {
+        reads[i] = percent(rng) < read_percent;
+    }
+    return reads;
+}
+
+template <class A>
+static void request_test(benchmark::State &state)
+{
+    std::vector<bool> reads = make_reads(state.range(0));
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        long sum = 0;
+        for (int r = 0; r < RequestCount; r++) {
+            A slots[SlotCount];
+            for (int i = 0; i < SlotCount; i++) {
+                if constexpr (std::is_same_v<A, Cyto::Any>) {
+                    slots[i].template emplace<NeedsAlloc>(i);
+                }
+                else {
+                    slots[i] = A(std::in_place_type<NeedsAlloc>, i);
+                }
+            }
+            for (int i = 0; i < SlotCount; i++) {
+                if (reads[r * SlotCount + i]) {
+                    sum += Cyto::any_cast<NeedsAlloc>(&slots[i])->n1.i;
+                }
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+static void cyto_any_test(benchmark::State &state)
+{
+    request_test<Cyto::Any>(state);
+}
+
+static void cyto_lazy_any_test(benchmark::State &state)
+{
+    request_test<Cyto::LazyAny>(state);
+}
+
+static void cyto_sync_lazy_any_test(benchmark::State &state)
+{
+    request_test<Cyto::SyncLazyAny>(state);
+}
+
+BENCHMARK(cyto_any_test)->Arg(10)->Arg(50)->Arg(100);
+BENCHMARK(cyto_lazy_any_test)->Arg(10)->Arg(50)->Arg(100);
+BENCHMARK(cyto_sync_lazy_any_test)->Arg(10)->Arg(50)->Arg(100);
+
+BENCHMARK_MAIN();
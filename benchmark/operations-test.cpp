@@ -0,0 +1,264 @@
+//
+// operations-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any-impls.h>
+#include <any-types.h>
+
+//
+// One benchmark per Any operation, run for every implementation and every type in
+// any-types.h, so a regression shows up in the operation and type that caused it
+// rather than in the total of a mixed loop. Each benchmark times its operation along
+// with destroying whatever the operation leaves behind, and starts from a steady
+// state, so that, for example, copy_assign_test always assigns over a value of the
+// same type, and move_test always moves into an empty Any.
+//
+
+template <class T>
+static T make_value(int i)
+{
+    return T(i);
+}
+
+template <>
+NonTrivialString make_value<NonTrivialString>(int i)
+{
+    return NonTrivialString("hello!");
+}
+
+template <>
+InitList<int> make_value<InitList<int>>(int i)
+{
+    return InitList<int>{i, i, i, i};
+}
+
+// None of the types in any-types.h is a double, so casts to it always miss.
+using MissType = double;
+
+template <class I, class T>
+static void construct_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    T v = make_value<T>(1);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        A a(v);
+        benchmark::DoNotOptimize(a);
+    }
+}
+
+template <class I, class T>
+static void copy_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    A a1 = make_value<T>(1);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        A a2(a1);
+        benchmark::DoNotOptimize(a2);
+    }
+}
+
+// Move the value back and forth between two Any instances, constructing a new one from
+// it each time in place of the empty one it was moved out of.
+template <class I, class T>
+static void move_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    A a1 = make_value<T>(1);
+    A a2;
+    A *from = &a1;
+    A *to = &a2;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        to->~A();
+        ::new (static_cast<void *>(to)) A(std::move(*from));
+        benchmark::DoNotOptimize(*to);
+        std::swap(from, to);
+    }
+}
+
+template <class I, class T>
+static void copy_assign_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    A a1 = make_value<T>(1);
+    A a2 = make_value<T>(2);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        a2 = a1;
+        benchmark::DoNotOptimize(a2);
+    }
+}
+
+template <class I, class T>
+static void move_assign_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    A a1 = make_value<T>(1);
+    A a2;
+    A *from = &a1;
+    A *to = &a2;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        *to = std::move(*from);
+        benchmark::DoNotOptimize(*to);
+        std::swap(from, to);
+    }
+}
+
+template <class I, class T>
+static void converting_assign_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    T v = make_value<T>(1);
+    A a = make_value<T>(2);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        a = v;
+        benchmark::DoNotOptimize(a);
+    }
+}
+
+template <class I, class T>
+static void emplace_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    T v = make_value<T>(1);
+    A a = make_value<T>(2);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        a.template emplace<T>(v);
+        benchmark::DoNotOptimize(a);
+    }
+}
+
+// Resetting an empty Any does nothing, so each reset needs a value made first. Subtract
+// construct_test for the cost of the reset alone.
+template <class I, class T>
+static void reset_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    T v = make_value<T>(1);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        A a(v);
+        a.reset();
+        benchmark::DoNotOptimize(a);
+    }
+}
+
+template <class I, class T>
+static void swap_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    A a1 = make_value<T>(1);
+    A a2 = make_value<T>(2);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        swap(a1, a2);
+        benchmark::DoNotOptimize(a1);
+        benchmark::DoNotOptimize(a2);
+    }
+}
+
+template <class I, class T>
+static void any_cast_hit_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    A a = make_value<T>(1);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        benchmark::DoNotOptimize(I::template any_cast<T>(&a));
+    }
+}
+
+template <class I, class T>
+static void any_cast_miss_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    A a = make_value<T>(1);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        benchmark::DoNotOptimize(I::template any_cast<MissType>(&a));
+    }
+}
+
+template <class I, class T>
+static void type_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    const A a = make_value<T>(1);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a);
+        benchmark::DoNotOptimize(&a.type());
+    }
+}
+
+//
+// Register a benchmark for each implementation and type, with the implementations of
+// each operation and type next to each other in the results.
+//
+#define OPERATION_BENCHMARK(op, T) \
+    BENCHMARK_TEMPLATE(op, StdAnyImpl, T)->Unit(benchmark::kNanosecond); \
+    BENCHMARK_TEMPLATE(op, XLLVMAnyImpl, T)->Unit(benchmark::kNanosecond); \
+    BENCHMARK_TEMPLATE(op, XGCCAnyImpl, T)->Unit(benchmark::kNanosecond); \
+    BENCHMARK_TEMPLATE(op, CytoAnyImpl, T)->Unit(benchmark::kNanosecond)
+
+#define OPERATION_BENCHMARKS(op) \
+    OPERATION_BENCHMARK(op, int); \
+    OPERATION_BENCHMARK(op, Trivial); \
+    OPERATION_BENCHMARK(op, NonTrivial); \
+    OPERATION_BENCHMARK(op, NonTrivialString); \
+    OPERATION_BENCHMARK(op, NeedsAlloc); \
+    OPERATION_BENCHMARK(op, SmallVector); \
+    OPERATION_BENCHMARK(op, InitList<int>)
+
+OPERATION_BENCHMARKS(construct_test);
+OPERATION_BENCHMARKS(copy_test);
+OPERATION_BENCHMARKS(move_test);
+OPERATION_BENCHMARKS(copy_assign_test);
+OPERATION_BENCHMARKS(move_assign_test);
+OPERATION_BENCHMARKS(converting_assign_test);
+OPERATION_BENCHMARKS(emplace_test);
+OPERATION_BENCHMARKS(reset_test);
+OPERATION_BENCHMARKS(swap_test);
+OPERATION_BENCHMARKS(any_cast_hit_test);
+OPERATION_BENCHMARKS(any_cast_miss_test);
+OPERATION_BENCHMARKS(type_test);
+
+BENCHMARK_MAIN();
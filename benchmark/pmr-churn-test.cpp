@@ -0,0 +1,159 @@
+//
+// pmr-churn-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <iostream>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any>
+
+#include <any-types.h>
+#include <cyto-any.h>
+#include <cyto-pmr-any.h>
+
+//
+// Fill a table with NeedsAlloc values, which are too large for inline storage, copy
+// the table, read every copy, and throw both away, over and over, as a request handler
+// might. Every value is a heap allocation for std::any and Cyto::Any. Cyto::PmrAny
+// takes them from a memory resource instead: a monotonic buffer on the stack that is
+// thrown away whole after each pass, and a pool that keeps its blocks from one pass
+// to the next.
+//
+static constexpr int ChurnCount = 64;
+
+static void std_any_test(benchmark::State &state)
+{
+    using A = std::any;
+    std::vector<A> values;
+    std::vector<A> copies;
+    values.reserve(ChurnCount);
+    copies.reserve(ChurnCount);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        for (int i = 0; i < ChurnCount; i++) {
+            values.emplace_back(NeedsAlloc(i));
+        }
+        for (const A &a : values) {
+            copies.push_back(a);
+        }
+        long sum = 0;
+        for (const A &a : copies) {
+            sum += std::any_cast<NeedsAlloc>(&a)->n4.i;
+        }
+        benchmark::DoNotOptimize(sum);
+        values.clear();
+        copies.clear();
+    }
+}
+
+static void cyto_any_test(benchmark::State &state)
+{
+    using A = Cyto::Any;
+    std::vector<A> values;
+    std::vector<A> copies;
+    values.reserve(ChurnCount);
+    copies.reserve(ChurnCount);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        for (int i = 0; i < ChurnCount; i++) {
+            values.emplace_back(NeedsAlloc(i));
+        }
+        for (const A &a : values) {
+            copies.push_back(a);
+        }
+        long sum = 0;
+        for (const A &a : copies) {
+            sum += Cyto::any_cast<NeedsAlloc>(&a)->n4.i;
+        }
+        benchmark::DoNotOptimize(sum);
+        values.clear();
+        copies.clear();
+    }
+}
+
+// Copies of a PmrAny take their values from the resource of the source, so one
+// allocator puts the whole pass in the resource.
+static long pmr_churn(std::vector<Cyto::PmrAny> &values, std::vector<Cyto::PmrAny> &copies,
+    const Cyto::PmrAny::allocator_type &alloc)
+{
+    using A = Cyto::PmrAny;
+    for (int i = 0; i < ChurnCount; i++) {
+        values.emplace_back(std::allocator_arg, alloc, NeedsAlloc(i));
+    }
+    for (const A &a : values) {
+        copies.push_back(a);
+    }
+    long sum = 0;
+    for (const A &a : copies) {
+        sum += Cyto::any_cast<NeedsAlloc>(&a)->n4.i;
+    }
+    values.clear();
+    copies.clear();
+    return sum;
+}
+
+static void cyto_pmr_any_monotonic_test(benchmark::State &state)
+{
+    using A = Cyto::PmrAny;
+    alignas(std::max_align_t) static unsigned char buffer[2 * ChurnCount * sizeof(NeedsAlloc)];
+    std::vector<A> values;
+    std::vector<A> copies;
+    values.reserve(ChurnCount);
+    copies.reserve(ChurnCount);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+        long sum = pmr_churn(values, copies, A::allocator_type(&resource));
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+static void cyto_pmr_any_pool_test(benchmark::State &state)
+{
+    using A = Cyto::PmrAny;
+    std::pmr::unsynchronized_pool_resource resource;
+    std::vector<A> values;
+    std::vector<A> copies;
+    values.reserve(ChurnCount);
+    copies.reserve(ChurnCount);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        long sum = pmr_churn(values, copies, A::allocator_type(&resource));
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+BENCHMARK(std_any_test)->Unit(benchmark::kNanosecond);
+BENCHMARK(cyto_any_test)->Unit(benchmark::kNanosecond);
+BENCHMARK(cyto_pmr_any_monotonic_test)->Unit(benchmark::kNanosecond);
+BENCHMARK(cyto_pmr_any_pool_test)->Unit(benchmark::kNanosecond);
+
+BENCHMARK_MAIN();
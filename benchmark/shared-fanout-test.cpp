@@ -0,0 +1,140 @@
+//
+// shared-fanout-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any>
+
+#include <any-types.h>
+#include <cyto-any.h>
+#include <cyto-shared-any.h>
+
+//
+// Copy one large message payload to a number of subscribers, each of which reads it,
+// the pattern Cyto::SharedAny is meant to speed up.
+//
+static constexpr int SubscriberCount = 32;
+
+static void std_any_test(benchmark::State &state)
+{
+    using A = std::any;
+    std::vector<A> subscribers;
+    subscribers.reserve(SubscriberCount);
+    int x = 0;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        int i = 0;
+        benchmark::DoNotOptimize(i += 1);
+        A message = NeedsAlloc(i);
+        for (int j = 0; j < SubscriberCount; j++) {
+            subscribers.push_back(message);
+        }
+        for (const A &a : subscribers) {
+            x += std::any_cast<const NeedsAlloc &>(a).n1.i;
+        }
+        subscribers.clear();
+    }
+    benchmark::DoNotOptimize(x);
+}
+
+static void cyto_any_test(benchmark::State &state)
+{
+    using A = Cyto::Any;
+    std::vector<A> subscribers;
+    subscribers.reserve(SubscriberCount);
+    int x = 0;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        int i = 0;
+        benchmark::DoNotOptimize(i += 1);
+        A message = NeedsAlloc(i);
+        for (int j = 0; j < SubscriberCount; j++) {
+            subscribers.push_back(message);
+        }
+        for (const A &a : subscribers) {
+            x += Cyto::any_cast<const NeedsAlloc &>(a).n1.i;
+        }
+        subscribers.clear();
+    }
+    benchmark::DoNotOptimize(x);
+}
+
+static void cyto_shared_any_test(benchmark::State &state)
+{
+    using A = Cyto::SharedAny;
+    std::vector<A> subscribers;
+    subscribers.reserve(SubscriberCount);
+    int x = 0;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        int i = 0;
+        benchmark::DoNotOptimize(i += 1);
+        A message = NeedsAlloc(i);
+        for (int j = 0; j < SubscriberCount; j++) {
+            subscribers.push_back(message);
+        }
+        for (const A &a : subscribers) {
+            x += Cyto::any_cast<const NeedsAlloc &>(a).n1.i;
+        }
+        subscribers.clear();
+    }
+    benchmark::DoNotOptimize(x);
+}
+
+static void cyto_local_shared_any_test(benchmark::State &state)
+{
+    using A = Cyto::LocalSharedAny;
+    std::vector<A> subscribers;
+    subscribers.reserve(SubscriberCount);
+    int x = 0;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        int i = 0;
+        benchmark::DoNotOptimize(i += 1);
+        A message = NeedsAlloc(i);
+        for (int j = 0; j < SubscriberCount; j++) {
+            subscribers.push_back(message);
+        }
+        for (const A &a : subscribers) {
+            x += Cyto::any_cast<const NeedsAlloc &>(a).n1.i;
+        }
+        subscribers.clear();
+    }
+    benchmark::DoNotOptimize(x);
+}
+
+BENCHMARK(std_any_test)->Unit(benchmark::kNanosecond);
+BENCHMARK(cyto_any_test)->Unit(benchmark::kNanosecond);
+BENCHMARK(cyto_shared_any_test)->Unit(benchmark::kNanosecond);
+BENCHMARK(cyto_local_shared_any_test)->Unit(benchmark::kNanosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,86 @@
+//
+// small-vector-move-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any-impls.h>
+#include <any-types.h>
+
+//
+// SmallVector fits in the inline storage of XLLVM::Any, XGCC::Any, and Cyto::Any,
+// and it owns a heap allocation, so any move that copies the value instead of
+// moving it shows up as an extra allocation and free.
+//
+
+template <class I>
+static void any_move_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    A r = SmallVector(0);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        int i = 0;
+        benchmark::DoNotOptimize(i += 1);
+        A a1 = SmallVector(i);
+        A a2(std::move(a1));
+        A a3;
+        a3 = std::move(a2);
+        swap(a3, r);
+    }
+    int x;
+    benchmark::DoNotOptimize(x = I::template any_cast<SmallVector>(&r)->v[0]);
+}
+
+template <class I>
+static void any_vector_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        std::vector<A> v;
+        for (int i = 0; i < 64; i++) {
+            v.emplace_back(SmallVector(i));
+        }
+        benchmark::DoNotOptimize(v.data());
+    }
+}
+
+BENCHMARK_TEMPLATE(any_move_test, StdAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_move_test, XLLVMAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_move_test, XGCCAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_move_test, CytoAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_vector_test, StdAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_vector_test, XLLVMAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_vector_test, XGCCAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_vector_test, CytoAnyImpl)->Unit(benchmark::kNanosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,99 @@
+//
+// sort-shuffle-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any-impls.h>
+#include <any-types.h>
+
+//
+// Shuffle and then sort a vector of Any instances holding a mix of small trivial
+// values (int), small non-trivial values (NonTrivial), and large values (NeedsAlloc),
+// so the benchmark measures how quickly an Any can be swapped and moved around.
+//
+static constexpr int SortCount = 256;
+
+template <class A>
+static std::vector<A> make_values()
+{
+    std::vector<A> v;
+    for (int i = 0; i < SortCount; i++) {
+        switch (i % 3) {
+            case 0:
+                v.emplace_back(i);
+                break;
+            case 1:
+                v.emplace_back(NonTrivial(i));
+                break;
+            default:
+                v.emplace_back(NeedsAlloc(i));
+                break;
+        }
+    }
+    return v;
+}
+
+template <class I>
+static int key(const typename I::Any &a)
+{
+    if (const int *p = I::template any_cast<int>(&a)) {
+        return *p;
+    }
+    if (const NonTrivial *p = I::template any_cast<NonTrivial>(&a)) {
+        return p->i;
+    }
+    return I::template any_cast<NeedsAlloc>(&a)->n1.i;
+}
+
+template <class I>
+static void any_test(benchmark::State &state)
+{
+    using A = typename I::Any;
+    std::vector<A> v = make_values<A>();
+    std::mt19937 rng(0);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        std::shuffle(v.begin(), v.end(), rng);
+        std::sort(v.begin(), v.end(), [](const A &a, const A &b) { return key<I>(a) < key<I>(b); });
+    }
+    int x;
+    benchmark::DoNotOptimize(x = key<I>(v[0]));
+}
+
+BENCHMARK_TEMPLATE(any_test, StdAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_test, XLLVMAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_test, XGCCAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_test, CytoAnyImpl)->Unit(benchmark::kNanosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,114 @@
+//
+// stats-mix-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <iostream>
+
+#ifndef ANY_USE_STATISTICS
+#define ANY_USE_STATISTICS 1
+#endif
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any-types.h>
+#include <cyto-any.h>
+
+//
+// Copy and move a vector of Any instances holding int, std::string, NonTrivial,
+// and NeedsAlloc values, with statistics on, and report the copies, moves, and heap
+// allocations of each type per iteration from Cyto::stats_snapshot(). Build it with
+// -DANY_USE_STATISTICS=0 to see what counting costs.
+//
+static constexpr int ValueCount = 256;
+
+static std::vector<Cyto::Any> make_values()
+{
+    std::vector<Cyto::Any> v;
+    v.reserve(ValueCount);
+    for (int i = 0; i < ValueCount; i++) {
+        switch (i % 4) {
+            case 0:
+                v.emplace_back(i);
+                break;
+            case 1:
+                v.emplace_back(std::string(i % 32, 'x'));
+                break;
+            case 2:
+                v.emplace_back(NonTrivial(i));
+                break;
+            default:
+                v.emplace_back(NeedsAlloc(i));
+                break;
+        }
+    }
+    return v;
+}
+
+#if ANY_USE(STATISTICS)
+static std::map<std::string, Cyto::AnyStats> snapshot()
+{
+    std::map<std::string, Cyto::AnyStats> result;
+    for (const Cyto::AnyTypeStats &t : Cyto::stats_snapshot()) {
+        result[t.name] = t.stats;
+    }
+    return result;
+}
+#endif
+
+static void cyto_any_test(benchmark::State &state)
+{
+    std::vector<Cyto::Any> values = make_values();
+#if ANY_USE(STATISTICS)
+    std::map<std::string, Cyto::AnyStats> before = snapshot();
+#endif
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        std::vector<Cyto::Any> copy(values);
+        std::vector<Cyto::Any> moved;
+        for (Cyto::Any &a : copy) {
+            moved.push_back(std::move(a));
+        }
+        benchmark::DoNotOptimize(moved.data());
+    }
+#if ANY_USE(STATISTICS)
+    double iterations = state.iterations();
+    for (auto &[name, after] : snapshot()) {
+        const Cyto::AnyStats &b = before[name];
+        state.counters[name + " copies"] = (after.copies - b.copies) / iterations;
+        state.counters[name + " moves"] = (after.moves - b.moves) / iterations;
+        state.counters[name + " allocs"] = (after.heap_allocations - b.heap_allocations) / iterations;
+    }
+#endif
+}
+
+BENCHMARK(cyto_any_test);
+
+BENCHMARK_MAIN();
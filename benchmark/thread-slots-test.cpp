@@ -0,0 +1,79 @@
+//
+// thread-slots-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any>
+
+#include <any-types.h>
+#include <cyto-any.h>
+
+//
+// Each thread repeatedly updates its own slot in a shared array of Any instances.
+// Four 32-byte Cyto::Any slots fit in two cache lines, so neighboring threads
+// invalidate each other's lines on every store, while every Cyto::CacheLineAny
+// slot has cache lines of its own.
+//
+static constexpr int SlotCount = 64;
+static constexpr int UpdateCount = 1024;
+
+template <class A>
+static void slots_test(benchmark::State &state)
+{
+    static std::vector<A> slots(SlotCount);
+    A &slot = slots[state.thread_index()];
+    slot = 0L;
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        for (int i = 0; i < UpdateCount; i++) {
+            long *p = Cyto::any_cast<long>(&slot);
+            slot = *p + 1;
+            benchmark::DoNotOptimize(slot);
+        }
+    }
+}
+
+static void cyto_any_test(benchmark::State &state)
+{
+    slots_test<Cyto::Any>(state);
+}
+
+static void cyto_cache_line_any_test(benchmark::State &state)
+{
+    slots_test<Cyto::CacheLineAny>(state);
+}
+
+BENCHMARK(cyto_any_test)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(cyto_cache_line_any_test)->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
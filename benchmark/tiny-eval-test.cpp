@@ -0,0 +1,163 @@
+//
+// tiny-eval-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any>
+
+#include <any-types.h>
+#include <cyto-any.h>
+#include <cyto-compact-any.h>
+#include <cyto-tiny-any.h>
+
+//
+// The operand stream of a small expression evaluator: a mix of double, int, and
+// bool values, which is folded into a running total by testing for each type in
+// turn, and then copied. Every value is stored inline by all of the Any types
+// here, so the difference between them comes down to size and to how cheaply
+// each one can answer "do you hold a T?".
+//
+static constexpr int OperandCount = 1 << 16;
+
+template <class A>
+static std::vector<A> make_operands()
+{
+    std::vector<A> v;
+    v.reserve(OperandCount);
+    for (int i = 0; i < OperandCount; i++) {
+        switch (i % 3) {
+            case 0:
+                v.emplace_back(i * 0.5);
+                break;
+            case 1:
+                v.emplace_back(i);
+                break;
+            default:
+                v.emplace_back((i & 4) != 0);
+                break;
+        }
+    }
+    return v;
+}
+
+template <class A>
+static double evaluate(const std::vector<A> &operands)
+{
+    using std::any_cast;
+    using Cyto::any_cast;
+    double total = 0;
+    for (const A &a : operands) {
+        if (const double *d = any_cast<double>(&a)) {
+            total += *d;
+        }
+        else if (const int *i = any_cast<int>(&a)) {
+            total *= *i & 1 ? 1.0 : 0.5;
+        }
+        else if (const bool *b = any_cast<bool>(&a)) {
+            total = *b ? -total : total;
+        }
+    }
+    return total;
+}
+
+template <class A>
+static void eval_test(benchmark::State &state)
+{
+    std::vector<A> operands = make_operands<A>();
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(evaluate(operands));
+    }
+}
+
+template <class A>
+static void copy_test(benchmark::State &state)
+{
+    std::vector<A> operands = make_operands<A>();
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        std::vector<A> copy(operands);
+        benchmark::DoNotOptimize(copy.data());
+    }
+}
+
+static void std_any_eval_test(benchmark::State &state)
+{
+    eval_test<std::any>(state);
+}
+
+static void cyto_any_eval_test(benchmark::State &state)
+{
+    eval_test<Cyto::Any>(state);
+}
+
+static void cyto_compact_any_eval_test(benchmark::State &state)
+{
+    eval_test<Cyto::CompactAny>(state);
+}
+
+static void cyto_tiny_any_eval_test(benchmark::State &state)
+{
+    eval_test<Cyto::TinyAny>(state);
+}
+
+static void std_any_copy_test(benchmark::State &state)
+{
+    copy_test<std::any>(state);
+}
+
+static void cyto_any_copy_test(benchmark::State &state)
+{
+    copy_test<Cyto::Any>(state);
+}
+
+static void cyto_compact_any_copy_test(benchmark::State &state)
+{
+    copy_test<Cyto::CompactAny>(state);
+}
+
+static void cyto_tiny_any_copy_test(benchmark::State &state)
+{
+    copy_test<Cyto::TinyAny>(state);
+}
+
+BENCHMARK(std_any_eval_test)->Unit(benchmark::kMicrosecond);
+BENCHMARK(cyto_any_eval_test)->Unit(benchmark::kMicrosecond);
+BENCHMARK(cyto_compact_any_eval_test)->Unit(benchmark::kMicrosecond);
+BENCHMARK(cyto_tiny_any_eval_test)->Unit(benchmark::kMicrosecond);
+BENCHMARK(std_any_copy_test)->Unit(benchmark::kMicrosecond);
+BENCHMARK(cyto_any_copy_test)->Unit(benchmark::kMicrosecond);
+BENCHMARK(cyto_compact_any_copy_test)->Unit(benchmark::kMicrosecond);
+BENCHMARK(cyto_tiny_any_copy_test)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -30,18 +30,17 @@
 
 #include <benchmark/benchmark.h>
 
-#include <any>
+#include <allocation-counters.h>
 
+#include <any-impls.h>
 #include <any-types.h>
-#include <xllvm-any.h>
-#include <xgcc-any.h>
-#include <cyto-any.h>
 
-static void std_any_test(benchmark::State &state)
+template <class I>
+static void any_test(benchmark::State &state)
 {
-    using namespace std;
-    using A = std::any;
+    using A = typename I::Any;
     A r;
+    AllocationCounters allocations(state);
     for (auto _ : state) {
         int i = 0;
         benchmark::DoNotOptimize(i += 1);
@@ -49,73 +48,16 @@ static void std_any_test(benchmark::State &state)
         A a1 = v1;    
         A a2(a1);    
         A a3 = a1;
-        Trivial v2 = std::any_cast<Trivial>(a3);
+        Trivial v2 = I::template any_cast<Trivial>(a3);
         r = v2;
     }
     int x;
-    benchmark::DoNotOptimize(x = std::any_cast<Trivial>(r).i);
+    benchmark::DoNotOptimize(x = I::template any_cast<Trivial>(r).i);
 }
 
-static void xllvm_any_test(benchmark::State &state)
-{
-    using namespace XLLVM;
-    using A = XLLVM::Any;
-    A r;
-    for (auto _ : state) {
-        int i = 0;
-        benchmark::DoNotOptimize(i += 1);
-        Trivial v1(i);
-        A a1 = v1;    
-        A a2(a1);    
-        A a3 = a1;
-        Trivial v2 = XLLVM::any_cast<Trivial>(a3);
-        r = v2;
-    }
-    int x;
-    benchmark::DoNotOptimize(x = XLLVM::any_cast<Trivial>(r).i);
-}
-
-static void xgcc_any_test(benchmark::State &state)
-{
-    using namespace XGCC;
-    using A = XGCC::Any;
-    A r;
-    for (auto _ : state) {
-        int i = 0;
-        benchmark::DoNotOptimize(i += 1);
-        Trivial v1(i);
-        A a1 = v1;    
-        A a2(a1);    
-        A a3 = a1;
-        Trivial v2 = XGCC::any_cast<Trivial>(a3);
-        r = v2;
-    }
-    int x;
-    benchmark::DoNotOptimize(x = XGCC::any_cast<Trivial>(r).i);
-}
-
-static void cyto_any_test(benchmark::State &state)
-{
-    using namespace Cyto;
-    using A = Cyto::Any;
-    A r;
-    for (auto _ : state) {
-        int i = 0;
-        benchmark::DoNotOptimize(i += 1);
-        Trivial v1(i);
-        A a1 = v1;    
-        A a2(a1);    
-        A a3 = a1;
-        Trivial v2 = Cyto::any_cast<Trivial>(a3);
-        r = v2;
-    }
-    int x;
-    benchmark::DoNotOptimize(x = Cyto::any_cast<Trivial>(r).i);
-}
-
-BENCHMARK(std_any_test)->Unit(benchmark::kNanosecond);
-BENCHMARK(xllvm_any_test)->Unit(benchmark::kNanosecond);
-BENCHMARK(xgcc_any_test)->Unit(benchmark::kNanosecond);
-BENCHMARK(cyto_any_test)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_test, StdAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_test, XLLVMAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_test, XGCCAnyImpl)->Unit(benchmark::kNanosecond);
+BENCHMARK_TEMPLATE(any_test, CytoAnyImpl)->Unit(benchmark::kNanosecond);
 
 BENCHMARK_MAIN();
@@ -0,0 +1,171 @@
+//
+// unique-any-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any>
+
+#include <any-types.h>
+#include <cyto-any.h>
+#include <cyto-unique-any.h>
+
+//
+// Push values through a two-stage queue, moving each one from the first stage to the
+// second and reading it there, as a task scheduler might. Values of two kinds that
+// Cyto::Any handles poorly go through it:
+//
+// A move-only std::unique_ptr, which Cyto::UniqueAny holds as is, and which Cyto::Any
+// can only hold by turning it into a copyable std::shared_ptr, with a control block
+// and atomic reference counts.
+//
+// MayThrowMove, which is two words in size but has a move constructor that isn't
+// noexcept. Cyto::Any can't hold it at all, std::any puts it on the heap, and
+// Cyto::UniqueAny stores it inline.
+//
+static constexpr int QueueCount = 64;
+
+struct MayThrowMove
+{
+    explicit MayThrowMove(int _i) : i(_i) {}
+    MayThrowMove(const MayThrowMove &other) : i(other.i) {}
+    MayThrowMove(MayThrowMove &&other) : i(other.i) {}
+    int i;
+    void *p = nullptr;
+};
+
+static void cyto_any_shared_ptr_test(benchmark::State &state)
+{
+    using A = Cyto::Any;
+    std::vector<A> first;
+    std::vector<A> second;
+    first.reserve(QueueCount);
+    second.reserve(QueueCount);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        for (int i = 0; i < QueueCount; i++) {
+            first.emplace_back(std::make_shared<NeedsAlloc>(i));
+        }
+        for (A &a : first) {
+            second.push_back(std::move(a));
+        }
+        long sum = 0;
+        for (const A &a : second) {
+            sum += (*Cyto::any_cast<std::shared_ptr<NeedsAlloc>>(&a))->n1.i;
+        }
+        benchmark::DoNotOptimize(sum);
+        first.clear();
+        second.clear();
+    }
+}
+
+static void cyto_unique_any_unique_ptr_test(benchmark::State &state)
+{
+    using A = Cyto::UniqueAny;
+    std::vector<A> first;
+    std::vector<A> second;
+    first.reserve(QueueCount);
+    second.reserve(QueueCount);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        for (int i = 0; i < QueueCount; i++) {
+            first.emplace_back(std::make_unique<NeedsAlloc>(i));
+        }
+        for (A &a : first) {
+            second.push_back(std::move(a));
+        }
+        long sum = 0;
+        for (const A &a : second) {
+            sum += (*Cyto::any_cast<std::unique_ptr<NeedsAlloc>>(&a))->n1.i;
+        }
+        benchmark::DoNotOptimize(sum);
+        first.clear();
+        second.clear();
+    }
+}
+
+static void std_any_may_throw_move_test(benchmark::State &state)
+{
+    using A = std::any;
+    std::vector<A> first;
+    std::vector<A> second;
+    first.reserve(QueueCount);
+    second.reserve(QueueCount);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        for (int i = 0; i < QueueCount; i++) {
+            first.emplace_back(MayThrowMove(i));
+        }
+        for (A &a : first) {
+            second.push_back(std::move(a));
+        }
+        long sum = 0;
+        for (const A &a : second) {
+            sum += std::any_cast<MayThrowMove>(&a)->i;
+        }
+        benchmark::DoNotOptimize(sum);
+        first.clear();
+        second.clear();
+    }
+}
+
+static void cyto_unique_any_may_throw_move_test(benchmark::State &state)
+{
+    using A = Cyto::UniqueAny;
+    std::vector<A> first;
+    std::vector<A> second;
+    first.reserve(QueueCount);
+    second.reserve(QueueCount);
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        for (int i = 0; i < QueueCount; i++) {
+            first.emplace_back(MayThrowMove(i));
+        }
+        for (A &a : first) {
+            second.push_back(std::move(a));
+        }
+        long sum = 0;
+        for (const A &a : second) {
+            sum += Cyto::any_cast<MayThrowMove>(&a)->i;
+        }
+        benchmark::DoNotOptimize(sum);
+        first.clear();
+        second.clear();
+    }
+}
+
+BENCHMARK(cyto_any_shared_ptr_test)->Unit(benchmark::kNanosecond);
+BENCHMARK(cyto_unique_any_unique_ptr_test)->Unit(benchmark::kNanosecond);
+BENCHMARK(std_any_may_throw_move_test)->Unit(benchmark::kNanosecond);
+BENCHMARK(cyto_unique_any_may_throw_move_test)->Unit(benchmark::kNanosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,149 @@
+//
+// visit-test.cpp
+//
+// MIT License
+// 
+// Copyright (c) 2020 Ken Kocienda
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <allocation-counters.h>
+
+#include <any>
+
+#include <any-types.h>
+#include <cyto-any.h>
+
+//
+// Find out what each Any in a vector holds, out of int, double, std::string,
+// NonTrivial, and NeedsAlloc, first with a chain of any_cast calls, and then with
+// Cyto::visit(), which compares the actions pointer against each handler's type
+// and only falls back to comparing type ids when none of them match.
+//
+static constexpr int ValueCount = 1024;
+
+template <class A>
+static std::vector<A> make_values()
+{
+    std::vector<A> v;
+    v.reserve(ValueCount);
+    for (int i = 0; i < ValueCount; i++) {
+        switch (i % 5) {
+            case 0:
+                v.emplace_back(i);
+                break;
+            case 1:
+                v.emplace_back(i * 0.5);
+                break;
+            case 2:
+                v.emplace_back(std::string(i % 16, 'x'));
+                break;
+            case 3:
+                v.emplace_back(NonTrivial(i));
+                break;
+            default:
+                v.emplace_back(NeedsAlloc(i));
+                break;
+        }
+    }
+    return v;
+}
+
+template <class A>
+static double chain_key(const A &a)
+{
+    using std::any_cast;
+    using Cyto::any_cast;
+    if (const int *p = any_cast<int>(&a)) {
+        return *p;
+    }
+    if (const double *p = any_cast<double>(&a)) {
+        return *p;
+    }
+    if (const std::string *p = any_cast<std::string>(&a)) {
+        return p->size();
+    }
+    if (const NonTrivial *p = any_cast<NonTrivial>(&a)) {
+        return p->i;
+    }
+    if (const NeedsAlloc *p = any_cast<NeedsAlloc>(&a)) {
+        return p->n1.i;
+    }
+    return 0;
+}
+
+template <class A>
+static void chain_test(benchmark::State &state)
+{
+    std::vector<A> values = make_values<A>();
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        double sum = 0;
+        for (const A &a : values) {
+            sum += chain_key(a);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+static void std_any_chain_test(benchmark::State &state)
+{
+    chain_test<std::any>(state);
+}
+
+static void cyto_any_chain_test(benchmark::State &state)
+{
+    chain_test<Cyto::Any>(state);
+}
+
+static void cyto_any_visit_test(benchmark::State &state)
+{
+    using A = Cyto::Any;
+    std::vector<A> values = make_values<A>();
+    auto key = Cyto::overloaded{
+        [](int x) { return double(x); },
+        [](double x) { return x; },
+        [](const std::string &x) { return double(x.size()); },
+        [](const NonTrivial &x) { return double(x.i); },
+        [](const NeedsAlloc &x) { return double(x.n1.i); },
+        [](const A &) { return 0.0; },
+    };
+    AllocationCounters allocations(state);
+    for (auto _ : state) {
+        double sum = 0;
+        for (const A &a : values) {
+            sum += Cyto::visit(a, key);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+BENCHMARK(std_any_chain_test);
+BENCHMARK(cyto_any_chain_test);
+BENCHMARK(cyto_any_visit_test);
+
+BENCHMARK_MAIN();
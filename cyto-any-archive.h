@@ -0,0 +1,314 @@
+//
+// cyto-any-archive.h
+//
+// A read-only, memory-mapped archive of Any values with zero-copy access.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef CYTO_ANY_ARCHIVE
+#define CYTO_ANY_ARCHIVE 1
+
+#ifndef ANY_USE_CODEC
+#define ANY_USE_CODEC 1
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cyto-any.h"
+
+#if !ANY_USE(CODEC)
+#error "cyto-any-archive.h needs ANY_USE_CODEC, so include it before cyto-any.h, or define ANY_USE_CODEC to 1"
+#endif
+
+namespace Cyto {
+
+//
+// An archive is a header, a table with the file offset of each value, and then
+// the values, as the records written by serialize(). Each record is padded so its
+// encoding starts on an AnyArchiveAlignment boundary. Since a mapped file starts on
+// a page boundary, the encodings of trivially copyable types can then be used in
+// place. Offsets are in the byte order of the machine, like the raw codecs.
+//
+constexpr char AnyArchiveMagic[8] = { 'C', 'Y', 'T', 'O', 'A', 'N', 'Y', '1' };
+constexpr size_t AnyArchiveAlignment = alignof(std::max_align_t);
+constexpr size_t AnyArchiveHeaderSize = sizeof(AnyArchiveMagic) + sizeof(uint64_t);
+
+//
+// Write count Any values to an archive file at path. Returns false if a value has no
+// codec, or if the file can't be written.
+//
+template <class A>
+bool write_any_archive(const char *path, const A *values, size_t count) {
+    std::vector<unsigned char> bytes;
+    {
+        AnyWriter w(bytes);
+        w.write(AnyArchiveMagic);
+        w.write(uint64_t(count));
+        size_t table = w.size();
+        for (size_t i = 0; i < count; i++) {
+            w.write(uint64_t(0));
+        }
+        static constexpr unsigned char Padding[AnyArchiveAlignment] = {};
+        for (size_t i = 0; i < count; i++) {
+            size_t misalignment = (w.size() + AnyCodecRecordHeaderSize) % AnyArchiveAlignment;
+            if (misalignment != 0) {
+                w.write(static_cast<const void *>(Padding), AnyArchiveAlignment - misalignment);
+            }
+            uint64_t offset = w.size();
+            if (!serialize(w, values[i])) {
+                return false;
+            }
+            w.overwrite(table + i * sizeof(offset), static_cast<const void *>(&offset), sizeof(offset));
+        }
+    }
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return (fclose(file) == 0) && ok;
+}
+
+template <class A> class BasicAnyArchive;
+
+//
+// A value in an archive. any_cast on a view of a trivially copyable type returns a
+// pointer into the mapped file. Other types are decoded into an A the first time they
+// are asked for, and kept for as long as the archive is open. Views are cheap to copy.
+//
+template <class A>
+class AnyView
+{
+public:
+    AnyView(const BasicAnyArchive<A> *archive, size_t index) : archive(archive), index(index) {}
+
+    bool has_value() const noexcept { return archive->tag(index) != 0; }
+
+    // The value, decoded into an A, which is empty if the record couldn't be read.
+    const A &materialize() const { return archive->materialize(index); }
+
+    template <class T>
+    const T *get() const {
+        uint64_t tag = archive->tag(index);
+        if (tag == 0 || tag != any_codec_tag<T>()) {
+            return nullptr;
+        }
+        if constexpr (IsRawAnyCodec<T>) {
+            const unsigned char *p = archive->encoding(index, sizeof(T));
+            if (p != nullptr && reinterpret_cast<uintptr_t>(p) % alignof(T) == 0) {
+                return reinterpret_cast<const T *>(p);
+            }
+        }
+        return any_cast<T>(&materialize());
+    }
+
+private:
+    const BasicAnyArchive<A> *archive;
+    size_t index;
+};
+
+// Unlike any_cast on an Any, this can throw, since a value that isn't mapped in place is
+// decoded on first use, which can allocate and run the codec of its type.
+template <class V, class A, class T = std::remove_cv_t<std::remove_reference_t<V>>>
+const T *any_cast(const AnyView<A> *v) {
+    return v ? v->template get<T>() : nullptr;
+}
+
+//
+// A read-only archive mapped into memory. Opening it maps the file and checks its
+// header and offset table size, so it takes the same time for any number of values.
+// The values are only touched when they're used. Access from several threads is safe,
+// and if two threads decode the same value at once, one of them throws its copy away.
+//
+template <class A>
+class BasicAnyArchive
+{
+public:
+    BasicAnyArchive() {}
+
+    explicit BasicAnyArchive(const char *path) {
+        open(path);
+    }
+
+    BasicAnyArchive(const BasicAnyArchive &) = delete;
+    BasicAnyArchive &operator=(const BasicAnyArchive &) = delete;
+
+    ~BasicAnyArchive() {
+        close();
+    }
+
+    bool open(const char *path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < AnyArchiveHeaderSize) {
+            ::close(fd);
+            return false;
+        }
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            return false;
+        }
+        base = static_cast<const unsigned char *>(p);
+        length = st.st_size;
+        uint64_t n;
+        memcpy(static_cast<void *>(&n), static_cast<const void *>(base + sizeof(AnyArchiveMagic)), sizeof(n));
+        if (memcmp(base, AnyArchiveMagic, sizeof(AnyArchiveMagic)) != 0 ||
+            n > (length - AnyArchiveHeaderSize) / sizeof(uint64_t)) {
+            close();
+            return false;
+        }
+        count = n;
+        if (count != 0) {
+            // Anonymous pages read as zero until they're written, so this costs nothing
+            // for values that are never decoded.
+            void *s = mmap(nullptr, count * sizeof(Slot), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (s == MAP_FAILED) {
+                close();
+                return false;
+            }
+            slots = static_cast<Slot *>(s);
+        }
+        return true;
+    }
+
+    void close() {
+        for (Decoded *d = decoded.exchange(nullptr, std::memory_order_acquire); d != nullptr; ) {
+            Decoded *next = d->next;
+            delete d;
+            d = next;
+        }
+        if (slots != nullptr) {
+            munmap(static_cast<void *>(slots), count * sizeof(Slot));
+            slots = nullptr;
+        }
+        if (base != nullptr) {
+            munmap(const_cast<unsigned char *>(base), length);
+            base = nullptr;
+        }
+        length = 0;
+        count = 0;
+    }
+
+    bool is_open() const noexcept { return base != nullptr; }
+    size_t size() const noexcept { return count; }
+
+    AnyView<A> operator[](size_t index) const { return AnyView<A>(this, index); }
+
+private:
+    friend class AnyView<A>;
+
+    struct Decoded
+    {
+        A value;
+        Decoded *next = nullptr;
+    };
+
+    using Slot = std::atomic<Decoded *>;
+    static_assert(sizeof(Slot) == sizeof(Decoded *) && Slot::is_always_lock_free, 
+        "decoded slots must be plain pointers, so zero pages read as null");
+
+    // The record of a value, or null if its offset or header lies outside the file.
+    const unsigned char *record(size_t index) const {
+        uint64_t offset;
+        memcpy(static_cast<void *>(&offset), 
+            static_cast<const void *>(base + AnyArchiveHeaderSize + index * sizeof(offset)), sizeof(offset));
+        if (offset > length || length - offset < AnyCodecRecordHeaderSize) {
+            return nullptr;
+        }
+        return base + offset;
+    }
+
+    uint64_t tag(size_t index) const {
+        const unsigned char *r = record(index);
+        uint64_t t = 0;
+        if (r != nullptr) {
+            memcpy(static_cast<void *>(&t), static_cast<const void *>(r), sizeof(t));
+        }
+        return t;
+    }
+
+    // The encoding of a value, or null if its size isn't the one expected, or it
+    // runs past the end of the file.
+    const unsigned char *encoding(size_t index, size_t expected) const {
+        const unsigned char *r = record(index);
+        if (r == nullptr) {
+            return nullptr;
+        }
+        uint32_t size;
+        memcpy(static_cast<void *>(&size), static_cast<const void *>(r + sizeof(uint64_t)), sizeof(size));
+        size_t offset = r - base + AnyCodecRecordHeaderSize;
+        if (size != expected || length - offset < size) {
+            return nullptr;
+        }
+        return base + offset;
+    }
+
+    const A &materialize(size_t index) const {
+        Slot &slot = slots[index];
+        if (Decoded *d = slot.load(std::memory_order_acquire)) {
+            return d->value;
+        }
+        // Owned until published, since deserialize can throw.
+        std::unique_ptr<Decoded> owned(new Decoded);
+        if (const unsigned char *r = record(index)) {
+            AnyReader reader(r, length - (r - base));
+            deserialize(reader, owned->value);
+        }
+        Decoded *expected = nullptr;
+        if (!slot.compare_exchange_strong(expected, owned.get(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+            return expected->value;
+        }
+        Decoded *d = owned.release();
+        d->next = decoded.load(std::memory_order_relaxed);
+        while (!decoded.compare_exchange_weak(d->next, d, std::memory_order_release, std::memory_order_relaxed)) {}
+        return d->value;
+    }
+
+    const unsigned char *base = nullptr;
+    size_t length = 0;
+    size_t count = 0;
+    Slot *slots = nullptr;
+    mutable std::atomic<Decoded *> decoded = nullptr;
+};
+
+using AnyArchive = BasicAnyArchive<Any>;
+
+}  // namespace Cyto
+
+#endif  // CYTO_ANY_ARCHIVE
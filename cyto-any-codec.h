@@ -0,0 +1,278 @@
+//
+// cyto-any-codec.h
+//
+// Per-type binary codecs for serializing Any values, enabled with ANY_USE_CODEC.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef CYTO_ANY_CODEC
+#define CYTO_ANY_CODEC 1
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef ANY_CODEC_REGISTRY_CAPACITY
+#define ANY_CODEC_REGISTRY_CAPACITY 1024
+#endif
+
+namespace Cyto {
+
+//
+// AnyWriter appends bytes to a vector, which can then be written to a file or pipe in
+// one call. It grows the vector ahead of its writes, so it only has to zero-fill and
+// copy on a doubling, and trims it back when it goes out of scope, or on finish(). Don't
+// look at the vector until then. AnyReader reads the bytes back. A read past the end
+// fills what it couldn't read with zeros and puts the reader in a failed state, so
+// codecs can read without checking each step, and callers check ok() at the end.
+//
+class AnyWriter
+{
+public:
+    explicit AnyWriter(std::vector<unsigned char> &bytes) : bytes(bytes), used(bytes.size()) {}
+    ~AnyWriter() { finish(); }
+
+    AnyWriter(const AnyWriter &) = delete;
+    AnyWriter &operator=(const AnyWriter &) = delete;
+
+    void write(const void *p, size_t n) {
+        if (__builtin_expect(bytes.size() - used < n, 0)) {
+            bytes.resize(std::max(bytes.size() * 2, std::max(used + n, size_t(256))));
+        }
+        memcpy(static_cast<void *>(bytes.data() + used), p, n);
+        used += n;
+    }
+
+    template <class T>
+    void write(const T &t) {
+        static_assert(std::is_trivially_copyable_v<T>, "write() copies raw bytes");
+        write(static_cast<const void *>(&t), sizeof(T));
+    }
+
+    void overwrite(size_t offset, const void *p, size_t n) {
+        memcpy(static_cast<void *>(bytes.data() + offset), p, n);
+    }
+
+    // Drop everything written after the first size bytes.
+    void truncate(size_t size) { used = std::min(used, size); }
+
+    void finish() { bytes.resize(used); }
+
+    size_t size() const { return used; }
+
+private:
+    std::vector<unsigned char> &bytes;
+    size_t used;
+};
+
+class AnyReader
+{
+public:
+    AnyReader(const void *data, size_t size) :
+        data(static_cast<const unsigned char *>(data)), end(static_cast<const unsigned char *>(data) + size) {}
+
+    bool read(void *p, size_t n) {
+        if (n > size_t(end - data)) {
+            memset(p, 0, n);
+            failed = true;
+            data = end;
+            return false;
+        }
+        memcpy(p, static_cast<const void *>(data), n);
+        data += n;
+        return true;
+    }
+
+    template <class T>
+    T read() {
+        static_assert(std::is_trivially_copyable_v<T>, "read() copies raw bytes");
+        T t{};
+        read(static_cast<void *>(&t), sizeof(T));
+        return t;
+    }
+
+    bool skip(size_t n) {
+        if (n > size_t(end - data)) {
+            failed = true;
+            data = end;
+            return false;
+        }
+        data += n;
+        return true;
+    }
+
+    const unsigned char *position() const { return data; }
+    bool at_end() const { return data == end; }
+    bool ok() const { return !failed; }
+
+private:
+    const unsigned char *data;
+    const unsigned char *end;
+    bool failed = false;
+};
+
+//
+// Specialize AnyCodec for a type to make values of that type serializable, like this:
+//
+//     template <> struct AnyCodec<std::string> {
+//         static constexpr const char *name = "std::string";
+//         static void encode(AnyWriter &w, const std::string &s);
+//         static std::string decode(AnyReader &r);
+//     };
+//
+// The name identifies the type in the byte stream, so it has to be the same in the
+// programs that write and read it. It's optional, and defaults to the compiler's name
+// for the type. Trivially copyable types get a codec that copies their bytes, in the
+// byte order of the machine, unless they have a specialization of their own. Pointers
+// and member pointers don't, since their bytes mean nothing in another process, so
+// they need a codec of their own to be serializable. Neither do structures that hold
+// pointers, though that can't be checked here, so give those a codec, too.
+//
+template <class T, class = void>
+struct AnyCodec {};
+
+template <class T>
+struct AnyCodec<T, std::enable_if_t<std::is_trivially_copyable_v<T> &&
+    !std::is_pointer_v<T> && !std::is_member_pointer_v<T>>>
+{
+    static constexpr bool Raw = true;
+
+    static void encode(AnyWriter &w, const T &t) {
+        w.write(static_cast<const void *>(&t), sizeof(T));
+    }
+};
+
+template <class T, class = void> struct HasAnyCodec_ : std::false_type {};
+template <class T> struct HasAnyCodec_<T, std::void_t<decltype(&AnyCodec<T>::encode)>> : std::true_type {};
+template <class T> constexpr bool HasAnyCodec = HasAnyCodec_<T>::value;
+
+template <class T, class = void> struct IsRawAnyCodec_ : std::false_type {};
+template <class T> struct IsRawAnyCodec_<T, std::void_t<decltype(AnyCodec<T>::Raw)>> : std::true_type {};
+template <class T> constexpr bool IsRawAnyCodec = IsRawAnyCodec_<T>::value;
+
+template <class T, class = void> struct AnyCodecName_ {
+    static const char *name() { return __PRETTY_FUNCTION__; }
+};
+template <class T> struct AnyCodecName_<T, std::void_t<decltype(AnyCodec<T>::name)>> {
+    static const char *name() { return AnyCodec<T>::name; }
+};
+
+// FNV-1a, which is plenty to tell a few hundred type names apart.
+inline uint64_t any_codec_tag(const char *name) {
+    uint64_t h = 0xcbf29ce484222325;
+    for (; *name; name++) {
+        h = (h ^ static_cast<unsigned char>(*name)) * 0x100000001b3;
+    }
+    return h == 0 ? 1 : h;
+}
+
+// The tag of a type with a codec, computed on first use.
+template <class T>
+uint64_t any_codec_tag() {
+    static const uint64_t tag = any_codec_tag(AnyCodecName_<T>::name());
+    return tag;
+}
+
+// Every record starts with a 64-bit tag and a 32-bit size, followed by the encoding.
+constexpr size_t AnyCodecRecordHeaderSize = sizeof(uint64_t) + sizeof(uint32_t);
+
+template <class S> struct AnyActions;
+
+//
+// The codec actions for a type stored in storage of type S. Decode makes a value in
+// the storage, and returns the actions for its type.
+//
+template <class S>
+struct AnyCodecActions
+{
+    using Encode = void (*)(AnyWriter &w, const S *s);
+    using Decode = const AnyActions<S> *(*)(AnyReader &r, S *s);
+
+    uint64_t tag;
+    Encode encode;
+    Decode decode;
+};
+
+//
+// The codec actions of every type with a codec that has been stored in an Any with
+// storage of type S, in an open-addressed table indexed by tag. Types register
+// themselves during static initialization, so lookups don't take a lock. Registering
+// more than half of Capacity types, or two types with the same tag, aborts, so raise
+// ANY_CODEC_REGISTRY_CAPACITY if a program needs more.
+//
+template <class S>
+class AnyCodecRegistry
+{
+public:
+    static constexpr size_t Capacity = ANY_CODEC_REGISTRY_CAPACITY;
+    static_assert((Capacity & (Capacity - 1)) == 0, "registry capacity must be a power of two");
+
+    static uint64_t add(const char *name, const AnyCodecActions<S> *actions) {
+        uint64_t tag = any_codec_tag(name);
+        std::lock_guard<std::mutex> guard(lock);
+        if (++count > Capacity / 2) {
+            abort();
+        }
+        size_t index = tag & (Capacity - 1);
+        for (; entries[index].actions; index = (index + 1) & (Capacity - 1)) {
+            if (entries[index].tag == tag) {
+                abort();
+            }
+        }
+        entries[index] = { tag, actions };
+        return tag;
+    }
+
+    static const AnyCodecActions<S> *lookup(uint64_t tag) {
+        size_t index = tag & (Capacity - 1);
+        for (; entries[index].actions; index = (index + 1) & (Capacity - 1)) {
+            if (entries[index].tag == tag) {
+                return entries[index].actions;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t tag;
+        const AnyCodecActions<S> *actions;
+    };
+
+    static inline std::mutex lock;
+    static inline size_t count = 0;
+    static inline Entry entries[Capacity] = {};
+};
+
+}  // namespace Cyto
+
+#endif  // CYTO_ANY_CODEC
@@ -25,13 +25,20 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#ifndef CYTO_ANY
+#define CYTO_ANY 1
+
+#include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <initializer_list>
+#include <memory>
 #include <new>
 #include <type_traits>
 #include <typeinfo>
 #include <utility>
 
+#include <stdlib.h>
 #include <string.h>
 
 #ifndef ANY_ALWAYS_INLINE
@@ -58,8 +65,36 @@
 #define ANY_USE_SMALL_MEMCPY_STRATEGY 0
 #endif
 
+#ifndef ANY_USE_SLAB_POOL
+#define ANY_USE_SLAB_POOL 0
+#endif
+
+#ifndef ANY_USE_CODEC
+#define ANY_USE_CODEC 0
+#endif
+
+#ifndef ANY_USE_STATISTICS
+#define ANY_USE_STATISTICS 0
+#endif
+
 #define ANY_USE(FEATURE) (defined ANY_USE_##FEATURE && ANY_USE_##FEATURE)
 
+#if ANY_USE(SLAB_POOL)
+#include "cyto-slab-pool.h"
+#endif
+
+#if ANY_USE(CODEC)
+#include "cyto-any-codec.h"
+#endif
+
+#if ANY_USE(STATISTICS)
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#endif
+
 namespace Cyto {
 
 #if ANY_USE(EXCEPTIONS)
@@ -79,28 +114,171 @@ template <class T>  struct IsInPlaceType_<std::in_place_type_t<T>> : std::true_t
 template <size_t S> struct IsInPlaceType_<std::in_place_index_t<S>> : std::true_type {};
 template <class T>  constexpr bool IsInPlaceType = IsInPlaceType_<T>::value;
 
-constexpr size_t StorageBufferSize = 3 * sizeof(void *);
-using StorageBuffer = std::aligned_storage_t<StorageBufferSize, std::alignment_of_v<void *>>;
-
-template <class T>
-using IsStorageBufferSized_ =
-    std::bool_constant<sizeof(T) <= sizeof(StorageBuffer) &&
-        std::alignment_of_v<StorageBuffer> % std::alignment_of_v<T> == 0>;
+//
+// A type is trivially relocatable if moving a value to a new address and destroying
+// the original has the same effect as copying its bytes and forgetting the original.
+// Trivially copyable types always are, and so are many types that aren't, like
+// std::unique_ptr, most handle types, and std::string in libc++. Specialize this
+// trait for such types, and Any relocates them with memcpy instead of calling their
+// move constructors and destructors.
+//
+template <class T> struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+template <class T> struct is_trivially_relocatable<std::unique_ptr<T>> : std::true_type {};
+template <class T> constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
 
-template <class T> constexpr bool IsStorageBufferSized = IsStorageBufferSized_<T>::value;
+constexpr size_t StorageBufferSize = 3 * sizeof(void *);
+constexpr size_t StorageBufferAlignment = std::alignment_of_v<void *>;
 
+template <size_t Size, size_t Align>
 union Storage
 {
+    using Buffer = std::aligned_storage_t<Size, Align>;
+
     constexpr Storage() {}
     Storage(const Storage &) = delete;
     Storage(Storage &&) = delete;
     Storage &operator=(const Storage &) = delete;
     Storage &operator=(Storage &&) = delete;
 
-    StorageBuffer buf;
+    Buffer buf;
     void *ptr = nullptr;
 };
 
+template <class T, class S>
+using IsStorageBufferSized_ =
+    std::bool_constant<sizeof(T) <= sizeof(typename S::Buffer) &&
+        std::alignment_of_v<typename S::Buffer> % std::alignment_of_v<T> == 0>;
+
+template <class T, class S> constexpr bool IsStorageBufferSized = IsStorageBufferSized_<T, S>::value;
+
+//
+// Values that don't fit in the storage buffer live in heap blocks made and dropped here.
+// Blocks come in the sizes given by HeapBlockSize, and with the alignment given by
+// HeapBlockAlignment, so the block of a value that's no longer needed can be reused
+// for a new value of another type with the same HeapBlockClass. Types with a class-
+// specific operator new are made with new X and have a block class of zero, which
+// means their blocks are never reused.
+//
+template <class X, class = void> struct HasClassOperatorNew_ : std::false_type {};
+template <class X> struct HasClassOperatorNew_<X, std::void_t<decltype(X::operator new(size_t()))>> : 
+    std::true_type {};
+
+template <class X> constexpr size_t HeapBlockAlignment = 
+    alignof(X) > __STDCPP_DEFAULT_NEW_ALIGNMENT__ ? alignof(X) : __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+template <class X> constexpr bool IsHeapOverAligned = alignof(X) > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+#if ANY_USE(SLAB_POOL)
+// Types with a class-specific operator new keep using it, even when they fit in a slab.
+template <class X> constexpr bool IsSlabPoolAllocated = IsSlabPoolSized<X> && !HasClassOperatorNew_<X>::value;
+#endif
+
+template <class X>
+constexpr size_t heap_block_size() {
+#if ANY_USE(SLAB_POOL)
+    if constexpr (IsSlabPoolAllocated<X>) {
+        return SlabPool::block_size(sizeof(X));
+    }
+#endif
+    if constexpr (HasClassOperatorNew_<X>::value) {
+        return 0;
+    }
+    constexpr size_t a = HeapBlockAlignment<X>;
+    return (sizeof(X) + a - 1) & ~(a - 1);
+}
+
+template <class X> constexpr size_t HeapBlockSize = heap_block_size<X>();
+
+// The block size, a multiple of the default new alignment, with the log2 of the block
+// alignment in its low bits for over-aligned blocks, which can only be reused for
+// values with the same alignment.
+template <class X>
+constexpr size_t heap_block_class() {
+    size_t c = HeapBlockSize<X>;
+    if (c != 0 && IsHeapOverAligned<X>) {
+        for (size_t a = HeapBlockAlignment<X>; a > 1; a >>= 1) {
+            c++;
+        }
+    }
+    return c;
+}
+
+template <class X> constexpr size_t HeapBlockClass = heap_block_class<X>();
+
+template <class X>
+ANY_ALWAYS_INLINE
+static void *heap_allocate() {
+#if ANY_USE(SLAB_POOL)
+    if constexpr (IsSlabPoolAllocated<X>) {
+        return SlabPool::allocate(sizeof(X));
+    }
+#endif
+    if constexpr (IsHeapOverAligned<X>) {
+        return ::operator new(HeapBlockSize<X>, std::align_val_t(HeapBlockAlignment<X>));
+    }
+    else {
+        return ::operator new(HeapBlockSize<X>);
+    }
+}
+
+template <class X>
+ANY_ALWAYS_INLINE
+static void heap_deallocate(void *p) {
+#if ANY_USE(SLAB_POOL)
+    if constexpr (IsSlabPoolAllocated<X>) {
+        SlabPool::deallocate(p, sizeof(X));
+        return;
+    }
+#endif
+    if constexpr (IsHeapOverAligned<X>) {
+        ::operator delete(p, HeapBlockSize<X>, std::align_val_t(HeapBlockAlignment<X>));
+    }
+    else {
+        ::operator delete(p, HeapBlockSize<X>);
+    }
+}
+
+// Make an X in the block at p, which comes from heap_allocate() for a type with the
+// same block class as X. If making it throws, the block is freed.
+template <class X, class... Args>
+ANY_ALWAYS_INLINE
+static X *heap_remake(void *p, Args &&... args) {
+#if ANY_USE(EXCEPTIONS)
+    try {
+        return ::new (p) X(std::forward<Args>(args)...);
+    }
+    catch (...) {
+        heap_deallocate<X>(p);
+        throw;
+    }
+#else
+    return ::new (p) X(std::forward<Args>(args)...);
+#endif
+}
+
+template <class X, class... Args>
+ANY_ALWAYS_INLINE
+static X *heap_make(Args &&... args) {
+    if constexpr (HeapBlockClass<X> == 0) {
+        return new X(std::forward<Args>(args)...);
+    }
+    else {
+        return heap_remake<X>(heap_allocate<X>(), std::forward<Args>(args)...);
+    }
+}
+
+template <class X>
+ANY_ALWAYS_INLINE
+static void heap_drop(X *x) {
+    if constexpr (HeapBlockClass<X> == 0) {
+        delete x;
+    }
+    else {
+        x->~X();
+        heap_deallocate<X>(x);
+    }
+}
+
 #if !ANY_USE(TYPEINFO)
 template <class T>
 struct fallback_typeinfo { static constexpr int id = 0; };
@@ -112,77 +290,351 @@ constexpr const void *fallback_typeid() {
 }
 #endif  // !ANY_USE(TYPEINFO)
 
+template <class S>
 ANY_ALWAYS_INLINE
-static constexpr void *void_get(Storage *s, const void *info) { return nullptr; }
+static constexpr void *void_get(S *s, const void *info) { return nullptr; }
 
+template <class S>
 ANY_ALWAYS_INLINE
-static constexpr void void_copy(Storage *dst, const Storage *src) {}
+static constexpr void void_copy(S *dst, const S *src) {}
 
+template <class S>
 ANY_ALWAYS_INLINE
-static constexpr void void_move(Storage *dst, Storage *src) {}
+static constexpr void void_relocate(S *dst, S *src) {}
 
+template <class S>
 ANY_ALWAYS_INLINE
-static constexpr void void_drop(Storage *s) {}
-        
+static constexpr void void_drop(S *s) {}
+
+//
+// The lifecycle events counted for each type when ANY_USE_STATISTICS is on. Every
+// value made in an Any counts as a construction, including copies, which are also
+// counted as copies. Assigning a value to an Any that holds one of the same type
+// counts as neither.
+//
+enum AnyStatsCounter : unsigned
+{
+    AnyConstructions,
+    AnyCopies,
+    AnyMoves,
+    AnyDrops,
+    AnyHeapAllocations,
+    AnyHeapBytes,
+    AnyStatsCounterCount,
+};
+
+#if ANY_USE(STATISTICS)
+struct AnyStats
+{
+    uint64_t constructions = 0;
+    uint64_t copies = 0;
+    uint64_t moves = 0;
+    uint64_t drops = 0;
+    uint64_t heap_allocations = 0;
+    uint64_t heap_bytes = 0;
+};
+
+struct AnyTypeStats
+{
+    std::string name;
+    AnyStats stats;
+};
+
+//
+// Each thread counts events for each type in its own Counters, so counting needs no
+// atomic read-modify-write operations, just a relaxed load and store that a snapshot
+// can read at the same time. Counters are never freed. When a thread exits, its
+// Counters are marked unused, and the next thread to count events for the same types
+// takes them over, so their counts carry on. Events a thread counts after that, like
+// drops in the destructors of its other thread_local values, go to Counters that
+// exiting threads share, with atomic adds.
+//
+class AnyStatsRegistry
+{
+public:
+    struct Counters
+    {
+        std::atomic<uint64_t> values[AnyStatsCounterCount] = {};
+        std::atomic<bool> in_use = true;
+        Counters *next = nullptr;
+        Counters *next_in_thread = nullptr;
+        Counters **slot = nullptr;
+    };
+
+    struct Type
+    {
+        std::string name;
+        Counters *counters = nullptr;
+        Counters *shared = nullptr;
+        Type *next = nullptr;
+    };
+
+    static Type *add(std::string name) {
+        std::lock_guard<std::mutex> guard(lock);
+        types = new Type{std::move(name), nullptr, nullptr, types};
+        return types;
+    }
+
+    // Find Counters for this thread to count the events of type in, and point slot, the
+    // thread's pointer to them, at them. Returns null if the thread has already released
+    // its Counters on its way out.
+    static Counters *attach(Type *type, Counters **slot) {
+        if (exited) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        Counters *c = type->counters;
+        for (; c != nullptr && c->in_use.load(std::memory_order_acquire); c = c->next) {}
+        if (c != nullptr) {
+            c->in_use.store(true, std::memory_order_relaxed);
+        }
+        else {
+            c = new Counters;
+            c->next = type->counters;
+            type->counters = c;
+        }
+        c->next_in_thread = local.counters;
+        c->slot = slot;
+        local.counters = c;
+        *slot = c;
+        return c;
+    }
+
+    // The Counters that exiting threads share for type, which are never marked unused.
+    static Counters *shared(Type *type) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (type->shared == nullptr) {
+            type->shared = new Counters;
+            type->shared->next = type->counters;
+            type->counters = type->shared;
+        }
+        return type->shared;
+    }
+
+    // The counts of every type that has been stored in an Any, summed over threads and
+    // storage sizes, and sorted by type name.
+    static std::vector<AnyTypeStats> snapshot() {
+        std::map<std::string, AnyStats> sums;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (Type *t = types; t != nullptr; t = t->next) {
+                AnyStats &s = sums[t->name];
+                for (Counters *c = t->counters; c != nullptr; c = c->next) {
+                    s.constructions += c->values[AnyConstructions].load(std::memory_order_relaxed);
+                    s.copies += c->values[AnyCopies].load(std::memory_order_relaxed);
+                    s.moves += c->values[AnyMoves].load(std::memory_order_relaxed);
+                    s.drops += c->values[AnyDrops].load(std::memory_order_relaxed);
+                    s.heap_allocations += c->values[AnyHeapAllocations].load(std::memory_order_relaxed);
+                    s.heap_bytes += c->values[AnyHeapBytes].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        std::vector<AnyTypeStats> result;
+        result.reserve(sums.size());
+        for (auto &entry : sums) {
+            result.push_back(AnyTypeStats{entry.first, entry.second});
+        }
+        return result;
+    }
+
+private:
+    // Clear the thread's pointers to its Counters before releasing them, so events it
+    // counts later don't go to Counters another thread may have taken over.
+    struct LocalCounters
+    {
+        ~LocalCounters() {
+            exited = true;
+            for (Counters *c = counters, *next; c != nullptr; c = next) {
+                // Once c is marked unused another thread may take it, so read on first.
+                next = c->next_in_thread;
+                *c->slot = nullptr;
+                c->in_use.store(false, std::memory_order_release);
+            }
+        }
+
+        Counters *counters;
+    };
+
+    static inline std::mutex lock;
+    static inline Type *types = nullptr;
+    static inline thread_local bool exited = false;
+    static inline thread_local LocalCounters local;
+};
+
+inline std::vector<AnyTypeStats> stats_snapshot() {
+    return AnyStatsRegistry::snapshot();
+}
+
+// The name of T, taken from the compiler's name for this function.
+template <class T>
+std::string any_stats_type_name() {
+    std::string name = __PRETTY_FUNCTION__;
+    size_t start = name.find("T = ");
+    if (start == std::string::npos) {
+        return name;
+    }
+    start += 4;
+    size_t end = name.find_first_of(";]", start);
+    return name.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+template <class T, class S>
+struct AnyStatsCounters
+{
+    ANY_ALWAYS_INLINE
+    static void count(AnyStatsCounter counter, uint64_t n) {
+        AnyStatsRegistry::Counters *c = local;
+        if (__builtin_expect(c == nullptr, 0)) {
+            static AnyStatsRegistry::Type *type = AnyStatsRegistry::add(any_stats_type_name<T>());
+            c = AnyStatsRegistry::attach(type, &local);
+            if (c == nullptr) {
+                AnyStatsRegistry::shared(type)->values[counter].fetch_add(n, std::memory_order_relaxed);
+                return;
+            }
+        }
+        std::atomic<uint64_t> &v = c->values[counter];
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static inline thread_local AnyStatsRegistry::Counters *local = nullptr;
+};
+#endif  // ANY_USE(STATISTICS)
+
+//
+// Bits in AnyActions::flags that describe how a type is stored, and which of its
+// actions do no more than copy the first word of the storage (TrivialCopy and
+// TrivialRelocate), copy the whole storage buffer (BitwiseRelocate), or do nothing
+// at all (TrivialDrop). Any checks these bits so it can skip calls through the
+// actions structure.
+//
+struct AnyFlags
+{
+    static constexpr unsigned Inline = 1 << 0;
+    static constexpr unsigned TrivialCopy = 1 << 1;
+    static constexpr unsigned TrivialRelocate = 1 << 2;
+    static constexpr unsigned TrivialDrop = 1 << 3;
+    static constexpr unsigned BitwiseRelocate = 1 << 4;
+    static constexpr unsigned Relocatable = TrivialRelocate | BitwiseRelocate;
+    static constexpr unsigned Void = TrivialCopy | TrivialRelocate | TrivialDrop;
+};
+
+template <class S>
 struct AnyActions
 {
-    using Get = void *(*)(Storage *s, const void *type);
-    using Copy = void (*)(Storage *dst, const Storage *src);
-    using Move = void (*)(Storage *dst, Storage *src);
-    using Drop = void (*)(Storage *s);
+    using Get = void *(*)(S *s, const void *type);
+    using Copy = void (*)(S *dst, const S *src);
+    using Relocate = void (*)(S *dst, S *src);
+    using Drop = void (*)(S *s);
 
     constexpr AnyActions() noexcept {}
 
-    constexpr AnyActions(Get g, Copy c, Move m, Drop d, const void *t) noexcept :
-        get(g), copy(c), move(m), drop(d), type(t) {}
+#if ANY_USE(CODEC)
+    constexpr AnyActions(Get g, Copy c, Relocate r, Drop d, Drop x, const void *t, unsigned f, size_t b,
+        const AnyCodecActions<S> *k) noexcept :
+        get(g), copy(c), relocate(r), drop(d), destroy(x), type(t), flags(f), block(b), codec(k) {}
+#else
+    constexpr AnyActions(Get g, Copy c, Relocate r, Drop d, Drop x, const void *t, unsigned f, size_t b) noexcept :
+        get(g), copy(c), relocate(r), drop(d), destroy(x), type(t), flags(f), block(b) {}
+#endif
 
-    Get get = void_get;
-    Copy copy = void_copy;
-    Move move = void_move;
-    Drop drop = void_drop;
+    Get get = void_get<S>;
+    Copy copy = void_copy<S>;
+    Relocate relocate = void_relocate<S>;
+    Drop drop = void_drop<S>;
+    // Like drop, but leaves the heap block of a heap-stored value allocated.
+    Drop destroy = void_drop<S>;
 #if ANY_USE(TYPEINFO)
     const void *type = static_cast<const void *>(&typeid(void));
 #else
     const void *type = fallback_typeid<void>();
+#endif
+    unsigned flags = AnyFlags::Void;
+    // The HeapBlockClass of a heap-stored value, and zero otherwise.
+    size_t block = 0;
+#if ANY_USE(CODEC)
+    // The codec actions of a type with an AnyCodec, and null otherwise.
+    const AnyCodecActions<S> *codec = nullptr;
 #endif
 };
 
-template <class T>
+#if ANY_USE(CODEC)
+template <class T, class S> struct AnyCodecTraits;
+#endif
+
+template <class T, class S>
 struct AnyTraits
 {
+    using Buffer = typename S::Buffer;
+
+    // Count an event for T, when ANY_USE_STATISTICS is on.
+    ANY_ALWAYS_INLINE
+    static void count(AnyStatsCounter counter, uint64_t n = 1) {
+#if ANY_USE(STATISTICS)
+        AnyStatsCounters<T, S>::count(counter, n);
+#endif
+    }
+
+    // Trivially copyable values no bigger than a pointer are copied and moved as one word.
+    template <class X>
+    static constexpr bool IsWordSized = sizeof(X) <= sizeof(void *) &&
+        std::alignment_of_v<void *> % std::alignment_of_v<X> == 0 && std::is_trivially_copyable_v<X>;
+
 #if ANY_USE(SMALL_MEMCPY_STRATEGY)
     template <class X = T, class... Args, 
-        std::enable_if_t<IsStorageBufferSized<X> && std::is_trivially_copyable_v<X>, int> = 0>
+        std::enable_if_t<IsStorageBufferSized<X, S> && std::is_trivially_copyable_v<X>, int> = 0>
     ANY_ALWAYS_INLINE
-    static X &make(Storage *s, std::in_place_type_t<X> vtype, Args &&... args) {
+    static X &make(S *s, std::in_place_type_t<X> vtype, Args &&... args) {
         X v(std::forward<Args>(args)...);
         memcpy(&s->buf, static_cast<void *>(&v), sizeof(X));
+        count(AnyConstructions);
         return *(static_cast<X *>(static_cast<void *>(&s->buf)));
     }
 
     template <class X = T, class... Args, 
-        std::enable_if_t<IsStorageBufferSized<X> && !std::is_trivially_copyable_v<X> &&
+        std::enable_if_t<IsStorageBufferSized<X, S> && !std::is_trivially_copyable_v<X> &&
             std::is_nothrow_move_constructible_v<X>, int> = 0>
     ANY_ALWAYS_INLINE
-    static X &make(Storage *s, std::in_place_type_t<X> vtype, Args &&... args) {
-        return *(::new (static_cast<void *>(&s->buf)) X(std::forward<Args>(args)...));
+    static X &make(S *s, std::in_place_type_t<X> vtype, Args &&... args) {
+        X *x = ::new (static_cast<void *>(&s->buf)) X(std::forward<Args>(args)...);
+        count(AnyConstructions);
+        return *x;
     }
 #else  // ANY_USE(SMALL_MEMCPY_STRATEGY)
     template <class X = T, class... Args, 
-        std::enable_if_t<IsStorageBufferSized<X> && 
+        std::enable_if_t<IsWordSized<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static X &make(S *s, std::in_place_type_t<X> vtype, Args &&... args) {
+        // Write the whole first word, so a word-sized TrivialCopy or TrivialRelocate
+        // that follows soon after reads back what the store wrote in one piece.
+        X v(std::forward<Args>(args)...);
+        void *w = nullptr;
+        memcpy(static_cast<void *>(&w), static_cast<void *>(&v), sizeof(X));
+        s->ptr = w;
+        count(AnyConstructions);
+        return *(static_cast<X *>(static_cast<void *>(&s->buf)));
+    }
+
+    template <class X = T, class... Args, 
+        std::enable_if_t<IsStorageBufferSized<X, S> && !IsWordSized<X> &&
             std::is_nothrow_move_constructible_v<X>, int> = 0>
     ANY_ALWAYS_INLINE
-    static X &make(Storage *s, std::in_place_type_t<X> vtype, Args &&... args) {
-        return *(::new (static_cast<void *>(&s->buf)) X(std::forward<Args>(args)...));
+    static X &make(S *s, std::in_place_type_t<X> vtype, Args &&... args) {
+        X *x = ::new (static_cast<void *>(&s->buf)) X(std::forward<Args>(args)...);
+        count(AnyConstructions);
+        return *x;
     }
 #endif  // ANY_USE(SMALL_MEMCPY_STRATEGY)
 
     template <class X = T, class... Args, 
-        std::enable_if_t<!IsStorageBufferSized<X>, int> = 0>
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
     ANY_ALWAYS_INLINE
-    static X &make(Storage *s, std::in_place_type_t<X> vtype, Args &&... args) {
-        s->ptr = new X(std::forward<Args>(args)...);
-        return *static_cast<X *>(s->ptr);
+    static X &make(S *s, std::in_place_type_t<X> vtype, Args &&... args) {
+        X *x = heap_make<X>(std::forward<Args>(args)...);
+        s->ptr = x;
+        count(AnyConstructions);
+        count(AnyHeapAllocations);
+        count(AnyHeapBytes, HeapBlockSize<X> != 0 ? HeapBlockSize<X> : sizeof(X));
+        return *x;
     }
 
 private:
@@ -207,14 +659,14 @@ private:
     template <class X = T, 
         std::enable_if_t<std::is_same_v<X, void>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void *get(Storage *s, const void *type) {
+    static void *get(S *s, const void *type) {
         return nullptr;
     }
 
     template <class X = T, 
-        std::enable_if_t<IsStorageBufferSized<X>, int> = 0>
+        std::enable_if_t<IsStorageBufferSized<X, S>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void *get(Storage *s, const void *type) {
+    static void *get(S *s, const void *type) {
         if (compare_typeid<X>(type)) {
             return static_cast<void *>(&s->buf);
         }
@@ -222,9 +674,9 @@ private:
     }
 
     template <class X = T, 
-        std::enable_if_t<!IsStorageBufferSized<X>, int> = 0>
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void *get(Storage *s, const void *type) {
+    static void *get(S *s, const void *type) {
         if (compare_typeid<X>(type)) {
             return s->ptr;
         }
@@ -237,69 +689,83 @@ private:
     template <class X = T, 
         std::enable_if_t<std::is_same_v<X, void>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void copy(Storage *dst, const Storage *src) {}
+    static void copy(S *dst, const S *src) {}
 
 #if ANY_USE(SMALL_MEMCPY_STRATEGY)
     template <class X = T, 
-        std::enable_if_t<IsStorageBufferSized<X> && std::is_trivially_copyable_v<X>, int> = 0>
+        std::enable_if_t<IsStorageBufferSized<X, S> && std::is_trivially_copyable_v<X>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void copy(Storage *dst, const Storage *src) {
-        memcpy(static_cast<void *>(&dst->buf), static_cast<void *>(const_cast<StorageBuffer *>(&src->buf)), sizeof(X));
+    static void copy(S *dst, const S *src) {
+        memcpy(static_cast<void *>(&dst->buf), static_cast<void *>(const_cast<Buffer *>(&src->buf)), sizeof(X));
+        count(AnyConstructions);
+        count(AnyCopies);
     }
 
     template <class X = T, 
-        std::enable_if_t<IsStorageBufferSized<X> && !std::is_trivially_copyable_v<X> && 
+        std::enable_if_t<IsStorageBufferSized<X, S> && !std::is_trivially_copyable_v<X> && 
             std::is_nothrow_move_constructible_v<X>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void copy(Storage *dst, const Storage *src) {
+    static void copy(S *dst, const S *src) {
         AnyTraits::make(dst, std::in_place_type_t<X>(), *static_cast<X const *>(static_cast<void const *>(&src->buf)));
+        count(AnyCopies);
     }
 #else  // ANY_USE(SMALL_MEMCPY_STRATEGY)
     template <class X = T, 
-        std::enable_if_t<IsStorageBufferSized<X> &&
+        std::enable_if_t<IsStorageBufferSized<X, S> &&
             std::is_nothrow_move_constructible_v<X>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void copy(Storage *dst, const Storage *src) {
+    static void copy(S *dst, const S *src) {
         AnyTraits::make(dst, std::in_place_type_t<X>(), *static_cast<X const *>(static_cast<void const *>(&src->buf)));
+        count(AnyCopies);
     }
 #endif   // ANY_USE(SMALL_MEMCPY_STRATEGY)
 
     template <class X = T, 
-        std::enable_if_t<!IsStorageBufferSized<X>, int> = 0>
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void copy(Storage *dst, const Storage *src) {
+    static void copy(S *dst, const S *src) {
         AnyTraits::make(dst, std::in_place_type_t<X>(), *static_cast<X const *>(static_cast<void const *>(src->ptr)));
+        count(AnyCopies);
     }
 
     //
-    // move
+    // relocate
+    //
+    // Move the value from src into dst, and destroy what's left in src, so the caller
+    // only needs to mark src as empty. Inline values are move-constructed, since they
+    // were only stored inline if their move constructors are noexcept, unless they are
+    // trivially relocatable, in which case their bytes are copied. Heap values just
+    // change hands.
     //
-#if ANY_USE(SMALL_MEMCPY_STRATEGY)
     template <class X = T, 
         std::enable_if_t<std::is_same_v<X, void>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void move(Storage *dst, Storage *src) {}
+    static void relocate(S *dst, S *src) {}
 
     template <class X = T, 
-        std::enable_if_t<IsStorageBufferSized<X>, int> = 0>
+        std::enable_if_t<IsStorageBufferSized<X, S> && is_trivially_relocatable_v<X>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void move(Storage *dst, Storage *src) {
-        memcpy(static_cast<void *>(&dst->buf), static_cast<void *>(const_cast<StorageBuffer *>(&src->buf)), sizeof(X));
+    static void relocate(S *dst, S *src) {
+        memcpy(static_cast<void *>(&dst->buf), static_cast<void *>(&src->buf), sizeof(X));
+        count(AnyMoves);
     }
-#else  // ANY_USE(SMALL_MEMCPY_STRATEGY)
+
     template <class X = T, 
-        std::enable_if_t<IsStorageBufferSized<X>, int> = 0>
+        std::enable_if_t<IsStorageBufferSized<X, S> && !is_trivially_relocatable_v<X>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void move(Storage *dst, Storage *src) {
-        AnyTraits::make(dst, std::in_place_type_t<X>(), std::move(*static_cast<X const *>(static_cast<void const *>(&src->buf))));
+    static void relocate(S *dst, S *src) {
+        X &t = *static_cast<X *>(static_cast<void *>(&src->buf));
+        ::new (static_cast<void *>(&dst->buf)) X(std::move(t));
+        t.~X();
+        count(AnyMoves);
     }
-#endif   // ANY_USE(SMALL_MEMCPY_STRATEGY)
 
     template <class X = T, 
-        std::enable_if_t<!IsStorageBufferSized<X>, int> = 0>
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void move(Storage *dst, Storage *src) {
+    static void relocate(S *dst, S *src) {
         dst->ptr = src->ptr;
+        count(AnyMoves);
     }
 
     //
@@ -308,43 +774,193 @@ private:
     template <class X = T, 
         std::enable_if_t<std::is_same_v<X, void>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void drop(Storage *s) {}
+    static void drop(S *s) {}
 
     template <class X = T, 
-        std::enable_if_t<std::is_trivially_destructible_v<X>, int> = 0>
+        std::enable_if_t<IsStorageBufferSized<X, S> && std::is_trivially_destructible_v<X>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void drop(Storage *s) {}
+    static void drop(S *s) {
+        count(AnyDrops);
+    }
 
     template <class X = T, 
-        std::enable_if_t<IsStorageBufferSized<X> && !std::is_trivially_destructible_v<X>, int> = 0>
+        std::enable_if_t<IsStorageBufferSized<X, S> && !std::is_trivially_destructible_v<X>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void drop(Storage *s) {
-        X &t = *static_cast<X *>(static_cast<void *>(const_cast<StorageBuffer *>(&s->buf)));
+    static void drop(S *s) {
+        X &t = *static_cast<X *>(static_cast<void *>(const_cast<Buffer *>(&s->buf)));
         t.~X();
+        count(AnyDrops);
     }
 
     template <class X = T, 
-        std::enable_if_t<!IsStorageBufferSized<X>, int> = 0>
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
     ANY_ALWAYS_INLINE
-    static void drop(Storage *s) {
-        delete static_cast<X *>(s->ptr);
+    static void drop(S *s) {
+        heap_drop(static_cast<X *>(s->ptr));
+        count(AnyDrops);
+    }
+
+    //
+    // destroy
+    //
+    template <class X = T, 
+        std::enable_if_t<std::is_same_v<X, void> || IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void destroy(S *s) {
+        drop<X>(s);
+    }
+
+    template <class X = T, 
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void destroy(S *s) {
+        static_cast<X *>(s->ptr)->~X();
+        count(AnyDrops);
+    }
+
+    //
+    // flags
+    //
+    // Counting events needs every action to run, so statistics turn off the trivial
+    // flags, and with them, the inline code BasicAny runs in place of the actions.
+    //
+#if ANY_USE(STATISTICS)
+    static constexpr unsigned flags = IsStorageBufferSized<T, S> ? AnyFlags::Inline : 0;
+#else
+    static constexpr unsigned flags = !IsStorageBufferSized<T, S> ? AnyFlags::TrivialRelocate :
+        AnyFlags::Inline |
+        (IsWordSized<T> ? AnyFlags::TrivialCopy : 0) |
+        (!is_trivially_relocatable_v<T> ? 0 :
+            sizeof(T) <= sizeof(void *) ? AnyFlags::TrivialRelocate : AnyFlags::BitwiseRelocate) |
+        (std::is_trivially_destructible_v<T> ? AnyFlags::TrivialDrop : 0);
+#endif
+
+#if ANY_USE(CODEC)
+    //
+    // codec
+    //
+    // Taking the address of the codec actions instantiates them, which registers the
+    // type, so any type that can be stored in an Any can also be read back into one.
+    //
+    static constexpr const AnyCodecActions<S> *codec() {
+        if constexpr (HasAnyCodec<T>) {
+            return &AnyCodecTraits<T, S>::actions;
+        }
+        else {
+            return nullptr;
+        }
     }
+#endif
 
 public:
-    static constexpr AnyActions actions = AnyActions(get<T>, copy<T>, move<T>, drop<T>, 
+    static constexpr AnyActions<S> actions = AnyActions<S>(get<T>, copy<T>, relocate<T>, drop<T>, destroy<T>,
 #if ANY_USE(TYPEINFO)
-        &typeid(T)
+        &typeid(T),
 #else
-        fallback_typeid<T>()  
+        fallback_typeid<T>(),
+#endif
+        flags, IsStorageBufferSized<T, S> ? 0 : HeapBlockClass<T>
+#if ANY_USE(CODEC)
+        , codec()
 #endif
     );
 };
 
-class Any;
+#if ANY_USE(CODEC)
+template <class T, class S>
+struct AnyCodecTraits
+{
+    static void encode(AnyWriter &w, const S *s) {
+        const void *p = IsStorageBufferSized<T, S> ? static_cast<const void *>(&s->buf) : s->ptr;
+        AnyCodec<T>::encode(w, *static_cast<const T *>(p));
+    }
+
+    // Raw values are read into an aligned buffer, then copied into the storage, which
+    // is a memcpy for a trivially copyable type.
+    template <class X = T, 
+        std::enable_if_t<IsRawAnyCodec<X>, int> = 0>
+    static const AnyActions<S> *decode(AnyReader &r, S *s) {
+        alignas(X) unsigned char b[sizeof(X)];
+        if (!r.read(static_cast<void *>(b), sizeof(X))) {
+            return nullptr;
+        }
+        AnyTraits<X, S>::make(s, std::in_place_type_t<X>(), *std::launder(reinterpret_cast<const X *>(b)));
+        return &AnyTraits<X, S>::actions;
+    }
+
+    template <class X = T, 
+        std::enable_if_t<!IsRawAnyCodec<X>, int> = 0>
+    static const AnyActions<S> *decode(AnyReader &r, S *s) {
+        X x = AnyCodec<X>::decode(r);
+        if (!r.ok()) {
+            return nullptr;
+        }
+        AnyTraits<X, S>::make(s, std::in_place_type_t<X>(), std::move(x));
+        return &AnyTraits<X, S>::actions;
+    }
+
+    static inline const AnyCodecActions<S> actions = {
+        AnyCodecRegistry<S>::add(AnyCodecName_<T>::name(), &AnyCodecTraits::actions), encode, decode<T>
+    };
+};
+#endif  // ANY_USE(CODEC)
+
+//
+// A policy for BasicAny that names the types a program stores most often. Before
+// calling through the actions structure to copy, relocate, or drop a value, BasicAny
+// compares its actions pointer with those of each hot type, and on a match, runs
+// that type's action directly, where the compiler can see it and inline it. Types
+// with trivial actions are handled by the flags before the hot types are checked,
+// so hot types pay off for non-trivial values, like std::string.
+//
+template <class... Ts>
+struct HotTypes
+{
+    template <class S>
+    ANY_ALWAYS_INLINE
+    static bool copy(const AnyActions<S> *actions, S *dst, const S *src) {
+        return ((actions == &AnyTraits<Ts, S>::actions && (AnyTraits<Ts, S>::actions.copy(dst, src), true)) || ...);
+    }
+
+    template <class S>
+    ANY_ALWAYS_INLINE
+    static bool relocate(const AnyActions<S> *actions, S *dst, S *src) {
+        return ((actions == &AnyTraits<Ts, S>::actions && (AnyTraits<Ts, S>::actions.relocate(dst, src), true)) || ...);
+    }
+
+    template <class S>
+    ANY_ALWAYS_INLINE
+    static bool drop(const AnyActions<S> *actions, S *s) {
+        return ((actions == &AnyTraits<Ts, S>::actions && (AnyTraits<Ts, S>::actions.drop(s), true)) || ...);
+    }
+};
+
+template <size_t Size, size_t Align = StorageBufferAlignment, class Hot = HotTypes<>> class BasicAny;
+
+template <class... Ts>
+using HotAny = BasicAny<StorageBufferSize, StorageBufferAlignment, HotTypes<Ts...>>;
+
+using Any = BasicAny<StorageBufferSize>;
+
+//
+// CacheLineAny stores values of up to a cache line in size and alignment inline, like
+// SIMD vectors and cache-line-aligned counters. It's aligned to a cache line, and its
+// size is a multiple of one, so neighboring Any slots in an array, say one per thread,
+// never share a cache line.
+//
+constexpr size_t CacheLineSize = 64;
+
+using CacheLineAny = BasicAny<CacheLineSize, CacheLineSize>;
+
+template <class A, class V, class... Fs> struct AnyVisitor;
+
+template <class T>  struct IsBasicAny_ : std::false_type {};
+template <size_t Size, size_t Align, class Hot> struct IsBasicAny_<BasicAny<Size, Align, Hot>> : std::true_type {};
+template <class T>  constexpr bool IsBasicAny = IsBasicAny_<T>::value;
 
 template <class V, class T = std::decay_t<V>>
 using IsAnyConstructible_ = 
-    std::bool_constant<!std::is_same_v<T, Any> && !IsInPlaceType<V> && 
+    std::bool_constant<!IsBasicAny<T> && !IsInPlaceType<V> && 
         std::is_copy_constructible_v<T>>;
 
 template <class V> constexpr bool IsAnyConstructible = IsAnyConstructible_<V>::value;
@@ -357,105 +973,150 @@ using IsAnyInitializerListConstructible_ =
 template <class T, class U, class ...Args> constexpr bool IsAnyInitializerListConstructible = 
     IsAnyInitializerListConstructible_<T, U, Args...>::value;
 
-class Any
+//
+// BasicAny holds values of size Size and alignment Align in its inline storage buffer,
+// and puts larger values on the heap. Cyto::Any uses a three-word buffer, like std::any.
+// Hot is a HotTypes policy, and HotAny<Ts...> is a Cyto::Any with Ts as its hot types.
+//
+template <size_t Size, size_t Align, class Hot>
+class BasicAny
 {
 public:
-    constexpr Any() noexcept : actions(VoidAnyActions) {}
+    using StorageType = Storage<Size, Align>;
+    using Actions = AnyActions<StorageType>;
+    template <class T> using Traits = AnyTraits<T, StorageType>;
+
+    template <class T> static constexpr bool IsInline = IsStorageBufferSized<T, StorageType>;
+
+    constexpr BasicAny() noexcept : actions(VoidAnyActions) {}
 
     template <class V, class T = std::decay_t<V>, std::enable_if_t<IsAnyConstructible<V>, int> = 0>
-    Any(V &&v) : actions(&AnyTraits<T>::actions) {
-        AnyTraits<T>::make(&storage, std::in_place_type_t<T>(), std::forward<V>(v));
+    BasicAny(V &&v) : actions(&Traits<T>::actions) {
+        Traits<T>::make(&storage, std::in_place_type_t<T>(), std::forward<V>(v));
     }
 
     template <class V, class... Args, class T = std::decay_t<V>, std::enable_if_t<IsAnyConstructible<T>, int> = 0>
-    explicit Any(std::in_place_type_t<V> vtype, Args &&... args) : actions(&AnyTraits<T>::actions) {
-        AnyTraits<T>::make(&storage, vtype, std::forward<Args>(args)...);
+    explicit BasicAny(std::in_place_type_t<V> vtype, Args &&... args) : actions(&Traits<T>::actions) {
+        Traits<T>::make(&storage, vtype, std::forward<Args>(args)...);
     }
 
     template <class V, class U, class ...Args, class T = std::decay_t<V>, 
         std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...>, int> = 0>
-    explicit Any(std::in_place_type_t<V> vtype, std::initializer_list<U> list, Args &&... args) :
-        actions(&AnyTraits<T>::actions) {
-        AnyTraits<T>::make(&storage, vtype, V{list, std::forward<Args>(args)...});
+    explicit BasicAny(std::in_place_type_t<V> vtype, std::initializer_list<U> list, Args &&... args) :
+        actions(&Traits<T>::actions) {
+        Traits<T>::make(&storage, vtype, V{list, std::forward<Args>(args)...});
     }
     
-    Any(const Any &other) : actions(other.actions) {
-        actions->copy(&storage, &other.storage);
+    BasicAny(const BasicAny &other) : actions(other.actions) {
+        copy_storage(other);
     }
 
-    Any(Any &&other) noexcept : actions(other.actions) {
-        actions->move(&storage, &other.storage);
+    BasicAny(BasicAny &&other) noexcept : actions(other.actions) {
+        relocate_storage(other);
         other.actions = VoidAnyActions;
     }
     
-    Any &operator=(const Any &other) {
+    BasicAny &operator=(const BasicAny &other) {
         if (this != &other) {
-            actions->drop(&storage);
+            drop_storage();
             actions = other.actions;
-            actions->copy(&storage, &other.storage);
+            copy_storage(other);
         }
         return *this;
     }
     
-    Any &operator=(Any &&other) noexcept {
+    BasicAny &operator=(BasicAny &&other) noexcept {
         if (this != &other) {
-            actions->drop(&storage);
+            drop_storage();
             actions = other.actions;
-            actions->move(&storage, &other.storage);
+            relocate_storage(other);
             other.actions = VoidAnyActions;
         }
         return *this;
     }
     
     template <class V, class T = std::decay_t<V>, std::enable_if_t<IsAnyConstructible<T>, int> = 0>
-    Any &operator=(V &&v) {
-        *this = Any(std::forward<V>(v));
+    BasicAny &operator=(V &&v) {
+        assign(std::forward<V>(v));
         return *this;
     }
 
-    ~Any() {
-        actions->drop(&storage);
+    // Store v and return a reference to the stored value. When this already holds a T,
+    // v is assigned to it, so its storage, including any heap block, is reused. If that
+    // assignment throws, this holds whatever T's assignment operator left behind. A T
+    // that goes on the heap can reuse the heap block of a value of another type, too.
+    // Since v might be owned by the value held now, the new T is made from v before the
+    // old value is destroyed, and then moved into the block, which can't throw. So if
+    // making the T throws, this still holds the old value.
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsAnyConstructible<T>, int> = 0>
+    T &assign(V &&v) {
+        if constexpr (std::is_assignable_v<T &, V>) {
+            if (actions == &Traits<T>::actions) {
+                T &t = *static_cast<T *>(value_ptr<T>());
+                t = std::forward<V>(v);
+                return t;
+            }
+        }
+        if constexpr (!IsInline<T> && HeapBlockClass<T> != 0 && std::is_nothrow_move_constructible_v<T>) {
+            if (actions->block == HeapBlockClass<T>) {
+                T t(std::forward<V>(v));
+                return replace<T>(std::move(t));
+            }
+        }
+        *this = BasicAny(std::forward<V>(v));
+        return *static_cast<T *>(value_ptr<T>());
+    }
+
+    ~BasicAny() {
+        drop_storage();
     }
     
     template <class V, class... Args, class T = std::decay_t<V>,
         std::enable_if_t<std::is_constructible_v<T, Args...> && std::is_copy_constructible_v<T>, int> = 0>
     T &emplace(Args &&... args) {
-        actions->drop(&storage);
-        actions = &AnyTraits<T>::actions;
-        return AnyTraits<T>::make(&storage, std::in_place_type_t<T>(), std::forward<Args>(args)...);
+        return replace<T>(std::forward<Args>(args)...);
     }
 
     template <class V, class U, class... Args, class T = std::decay_t<V>,
         std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...>, int> = 0>
     T &emplace(std::initializer_list<U> list, Args &&... args) {
-        reset();
-        actions = &AnyTraits<T>::actions;
-        return AnyTraits<T>::make(&storage, std::in_place_type_t<T>(), V{list, std::forward<Args>(args)...});
+        return replace<T>(V{list, std::forward<Args>(args)...});
     }
     
     ANY_ALWAYS_INLINE
     void reset() {
-        actions->drop(&storage);
+        drop_storage();
         actions = VoidAnyActions;
     }
 
     ANY_ALWAYS_INLINE
-    void swap(Any &rhs) noexcept {
+    void swap(BasicAny &rhs) noexcept {
         if (this == &rhs) {
             return;
         }
 
-        Any tmp;
+        // When both values can be relocated with memcpy, which includes empty and
+        // heap-stored values, exchange the storage bytes and the actions pointers.
+        if ((actions->flags & AnyFlags::Relocatable) && (rhs.actions->flags & AnyFlags::Relocatable)) {
+            alignas(StorageType) unsigned char tmp[sizeof(StorageType)];
+            memcpy(static_cast<void *>(tmp), static_cast<const void *>(&rhs.storage), sizeof(StorageType));
+            memcpy(static_cast<void *>(&rhs.storage), static_cast<const void *>(&storage), sizeof(StorageType));
+            memcpy(static_cast<void *>(&storage), static_cast<const void *>(tmp), sizeof(StorageType));
+            std::swap(actions, rhs.actions);
+            return;
+        }
+
+        BasicAny tmp;
         
         // swap storage
-        rhs.actions->move(&tmp.storage, &rhs.storage);
-        actions->move(&rhs.storage, &storage);
-        rhs.actions->move(&storage, &tmp.storage);
-
-        // swap actions
         tmp.actions = rhs.actions;
+        tmp.relocate_storage(rhs);
         rhs.actions = actions;
+        rhs.relocate_storage(*this);
         actions = tmp.actions;
+        relocate_storage(tmp);
+
+        tmp.actions = VoidAnyActions;
     }
 
     template <bool B>
@@ -471,21 +1132,210 @@ public:
     }
 #endif
 
-    template <class V> friend std::remove_cv_t<std::remove_reference_t<V>> *any_cast(Any *a) noexcept;
+    template <class V, size_t S, size_t A, class H>
+    friend std::remove_cv_t<std::remove_reference_t<V>> *any_cast(BasicAny<S, A, H> *a) noexcept;
+
+    template <class A, class V, class... Fs>
+    friend struct AnyVisitor;
+
+#if ANY_USE(CODEC)
+    template <size_t S, size_t A, class H>
+    friend bool serialize(AnyWriter &w, const BasicAny<S, A, H> &a);
+
+    template <size_t S, size_t A, class H>
+    friend bool deserialize(AnyReader &r, BasicAny<S, A, H> &a);
+#endif
 
 private:
-    static constexpr AnyActions _VoidAnyActions = AnyActions();
-    static constexpr const AnyActions * const VoidAnyActions = &_VoidAnyActions;
+    // Copy, move, and drop the value held by other or this, with inline code for
+    // the cases the actions flags say are trivial, and with calls through the
+    // actions structure otherwise. These expect actions to be set to the actions
+    // of the value being copied or moved. A heap-stored value moves as a pointer,
+    // so its move is trivial, too.
+    ANY_ALWAYS_INLINE
+    void copy_storage(const BasicAny &other) {
+        if (actions->flags & AnyFlags::TrivialCopy) {
+            memcpy(static_cast<void *>(&storage), static_cast<const void *>(&other.storage), sizeof(void *));
+        }
+        else if (!Hot::copy(actions, &storage, &other.storage)) {
+            actions->copy(&storage, &other.storage);
+        }
+    }
+
+    ANY_ALWAYS_INLINE
+    void relocate_storage(BasicAny &other) noexcept {
+        if (actions->flags & AnyFlags::TrivialRelocate) {
+            memcpy(static_cast<void *>(&storage), static_cast<const void *>(&other.storage), sizeof(void *));
+        }
+        else if (actions->flags & AnyFlags::BitwiseRelocate) {
+            memcpy(static_cast<void *>(&storage), static_cast<const void *>(&other.storage), sizeof(StorageType));
+        }
+        else if (!Hot::relocate(actions, &storage, &other.storage)) {
+            actions->relocate(&storage, &other.storage);
+        }
+    }
+
+    ANY_ALWAYS_INLINE
+    void drop_storage() noexcept {
+        if (!(actions->flags & AnyFlags::TrivialDrop) && !Hot::drop(actions, &storage)) {
+            actions->drop(&storage);
+        }
+    }
+
+    // Replace the value held by this with a T made from args. A T that goes on the heap
+    // is made in the block of the heap value held now, when their block classes match.
+    // The value held now is destroyed first, as emplace() allows, so args must not refer
+    // to it. If making the T throws, this is left empty.
+    template <class T, class... Args>
+    T &replace(Args &&... args) {
+        if constexpr (!IsInline<T> && HeapBlockClass<T> != 0) {
+            if (actions->block == HeapBlockClass<T>) {
+                void *p = storage.ptr;
+                actions->destroy(&storage);
+                actions = VoidAnyActions;
+                T *t = heap_remake<T>(p, std::forward<Args>(args)...);
+                storage.ptr = t;
+                actions = &Traits<T>::actions;
+                Traits<T>::count(AnyConstructions);
+                return *t;
+            }
+        }
+        reset();
+        T &t = Traits<T>::make(&storage, std::in_place_type_t<T>(), std::forward<Args>(args)...);
+        actions = &Traits<T>::actions;
+        return t;
+    }
+
+    // The location of a value of type U, which this must hold.
+    template <class U>
+    ANY_ALWAYS_INLINE
+    void *value_ptr() noexcept {
+        return IsInline<U> ? static_cast<void *>(&storage.buf) : storage.ptr;
+    }
+
+    // Every stored type has its own actions structure, so when the actions pointer matches,
+    // the location of the value is known at compile time, and there's no need to call get().
+    // The pointers can differ for the same type when values cross shared library boundaries,
+    // so fall back to comparing type ids before giving up.
+    template <class U, std::enable_if_t<IsAnyConstructible<U>, int> = 0>
+    ANY_ALWAYS_INLINE
+    void *get() noexcept {
+        if (actions == &Traits<U>::actions) {
+            return value_ptr<U>();
+        }
+        return get_slow<U>();
+    }
 
-    const AnyActions *actions;
-    Storage storage;
+    template <class U, std::enable_if_t<!IsAnyConstructible<U>, int> = 0>
+    ANY_ALWAYS_INLINE
+    void *get() noexcept {
+        return nullptr;
+    }
+
+    template <class U>
+    void *get_slow() noexcept {
+        if (has_value<false>()) {
+            return nullptr;
+        }
+#if ANY_USE(TYPEINFO)
+        if (*static_cast<const std::type_info *>(actions->type) != typeid(U)) {
+            return nullptr;
+        }
+#else
+        if (actions->type != fallback_typeid<U>()) {
+            return nullptr;
+        }
+#endif
+        return (actions->flags & AnyFlags::Inline) ? static_cast<void *>(&storage.buf) : storage.ptr;
+    }
+
+    static constexpr Actions _VoidAnyActions = Actions();
+    static constexpr const Actions * const VoidAnyActions = &_VoidAnyActions;
+
+    const Actions *actions;
+    StorageType storage;
 };
 
+template <size_t Size, size_t Align, class Hot>
 ANY_ALWAYS_INLINE
-void swap(Any &lhs, Any &rhs) noexcept {
+void swap(BasicAny<Size, Align, Hot> &lhs, BasicAny<Size, Align, Hot> &rhs) noexcept {
     lhs.swap(rhs);
 }
 
+#if ANY_USE(CODEC)
+//
+// Write the value held by an Any as a record of its codec tag, the size of its encoding,
+// and the encoding, which is one call through the codec actions of its type, so writing
+// out a range of Any instances is a single pass with no probing for types. An empty Any
+// writes a record with tag zero. Returns false, and writes nothing, if the type of the
+// value has no codec, or if its encoding doesn't fit in the 32-bit size of a record.
+//
+template <size_t Size, size_t Align, class Hot>
+bool serialize(AnyWriter &w, const BasicAny<Size, Align, Hot> &a) {
+    auto codec = a.actions->codec;
+    uint64_t tag = codec ? codec->tag : 0;
+    if (codec == nullptr && a.has_value()) {
+        return false;
+    }
+    uint32_t size = 0;
+    size_t offset = w.size();
+    w.write(tag);
+    w.write(size);
+    if (codec) {
+        codec->encode(w, &a.storage);
+        size_t n = w.size() - offset - sizeof(tag) - sizeof(size);
+        if (n > UINT32_MAX) {
+            w.truncate(offset);
+            return false;
+        }
+        size = uint32_t(n);
+        w.overwrite(offset + sizeof(tag), static_cast<const void *>(&size), sizeof(size));
+    }
+    return true;
+}
+
+//
+// Read a record written by serialize into an Any, which is left empty if the record
+// is for an empty Any, or if reading fails. The codec reads from the record alone, and
+// the reader moves to the end of the record whether or not it can be decoded, so when
+// a record has a tag that no type in this program has registered, or its encoding is
+// bad, the records after it can still be read. The codecs trust their input, so only
+// read bytes written by a program you trust.
+//
+template <size_t Size, size_t Align, class Hot>
+bool deserialize(AnyReader &r, BasicAny<Size, Align, Hot> &a) {
+    using StorageType = Storage<Size, Align>;
+    a.reset();
+    uint64_t tag = r.read<uint64_t>();
+    uint32_t size = r.read<uint32_t>();
+    if (!r.ok()) {
+        return false;
+    }
+    const unsigned char *start = r.position();
+    if (!r.skip(size)) {
+        return false;
+    }
+    if (tag == 0) {
+        return size == 0;
+    }
+    auto codec = AnyCodecRegistry<StorageType>::lookup(tag);
+    if (codec == nullptr) {
+        return false;
+    }
+    AnyReader record(start, size);
+    auto actions = codec->decode(record, &a.storage);
+    if (actions == nullptr) {
+        return false;
+    }
+    a.actions = actions;
+    if (!record.at_end()) {
+        a.reset();
+        return false;
+    }
+    return true;
+}
+#endif  // ANY_USE(CODEC)
+
 template <class T, class ...Args>
 ANY_ALWAYS_INLINE
 Any make_any(Args&&... args) {
@@ -498,9 +1348,9 @@ Any make_any(std::initializer_list<U> il, Args&&... args) {
     return Any(std::in_place_type<T>, il, std::forward<Args>(args)...);
 }
 
-template <class V, class T = std::remove_cv_t<std::remove_reference_t<V>>, 
+template <class V, size_t Size, size_t Align, class Hot, class T = std::remove_cv_t<std::remove_reference_t<V>>, 
     std::enable_if_t<std::is_constructible<V, const T &>{}, int> = 0>
-V any_cast(const Any &a) {
+V any_cast(const BasicAny<Size, Align, Hot> &a) {
     auto tmp = any_cast<std::add_const_t<T>>(&a);
     if (tmp == nullptr) {
         handle_bad_any_cast();
@@ -508,9 +1358,9 @@ V any_cast(const Any &a) {
     return static_cast<V>(*tmp);
 }
 
-template <class V, class T = std::remove_cv_t<std::remove_reference_t<V>>, 
+template <class V, size_t Size, size_t Align, class Hot, class T = std::remove_cv_t<std::remove_reference_t<V>>, 
     std::enable_if_t<std::is_constructible<V, const T &>{}, int> = 0>
-V any_cast(Any &a) {
+V any_cast(BasicAny<Size, Align, Hot> &a) {
     auto tmp = any_cast<T>(&a);
     if (tmp == nullptr) {
         handle_bad_any_cast();
@@ -518,9 +1368,9 @@ V any_cast(Any &a) {
     return static_cast<V>(*tmp);
 }
 
-template <class V, class T = std::remove_cv_t<std::remove_reference_t<V>>, 
+template <class V, size_t Size, size_t Align, class Hot, class T = std::remove_cv_t<std::remove_reference_t<V>>, 
     std::enable_if_t<std::is_constructible<V, const T &>{}, int> = 0>
-V any_cast(Any &&a) {
+V any_cast(BasicAny<Size, Align, Hot> &&a) {
     auto tmp = any_cast<T>(&a);
     if (tmp == nullptr) {
         handle_bad_any_cast();
@@ -528,26 +1378,165 @@ V any_cast(Any &&a) {
     return static_cast<V>(std::move(*tmp));
 }
 
-template <class V, class T = std::remove_cv_t<std::remove_reference_t<V>>>
-const T *any_cast(const Any *a) noexcept {
-    return any_cast<V>(const_cast<Any *>(a));
+template <class V, size_t Size, size_t Align, class Hot, class T = std::remove_cv_t<std::remove_reference_t<V>>>
+const T *any_cast(const BasicAny<Size, Align, Hot> *a) noexcept {
+    return any_cast<V>(const_cast<BasicAny<Size, Align, Hot> *>(a));
 }
 
-template <class V>
-std::remove_cv_t<std::remove_reference_t<V>> *any_cast(Any *a) noexcept {
+template <class V, size_t Size, size_t Align, class Hot>
+std::remove_cv_t<std::remove_reference_t<V>> *any_cast(BasicAny<Size, Align, Hot> *a) noexcept {
     using T = std::remove_cv_t<std::remove_reference_t<V>>;
     using U = std::decay_t<V>;
-    if (a && a->has_value()) {
-        void *p = a->actions->get(&a->storage, 
+    if (a) {
+        void *p = a->template get<U>();
+        return (std::is_function<V>{}) ? nullptr : static_cast<T *>(p);
+    }
+    return nullptr;
+}
+
+//
+// visit(a, overloaded{handlers...}) calls the handler whose parameter type matches the
+// type of the value in a. The parameter types are read from the handlers' function
+// call operators, so the lookup is one compare of a's actions pointer per handler,
+// with no calls through the actions structure. If nothing matches, a handler that
+// takes the Any itself, or a generic handler, is called with a as a fallback. A
+// visitor without a fallback does nothing for unmatched values, so it must return
+// void. A single lambda can be passed in place of an overloaded.
+//
+template <class... Fs>
+struct overloaded : Fs...
+{
+    using Fs::operator()...;
+};
+
+template <class... Fs> overloaded(Fs...) -> overloaded<Fs...>;
+
+template <class M> struct VisitorMember_ { using Arg = void; using Result = void; };
+template <class R, class C, class A> struct VisitorMember_<R (C::*)(A)> { using Arg = A; using Result = R; };
+template <class R, class C, class A> struct VisitorMember_<R (C::*)(A) const> { using Arg = A; using Result = R; };
+template <class R, class C, class A> struct VisitorMember_<R (C::*)(A) noexcept> { using Arg = A; using Result = R; };
+template <class R, class C, class A> struct VisitorMember_<R (C::*)(A) const noexcept> { using Arg = A; using Result = R; };
+
+template <class F, class = void> struct VisitorHandler_ : VisitorMember_<void> {};
+template <class F> struct VisitorHandler_<F, std::void_t<decltype(&F::operator())>> :
+    VisitorMember_<decltype(&F::operator())> {};
+
+template <class F> using VisitorArg = typename VisitorHandler_<F>::Arg;
+template <class F> using VisitorValue = std::decay_t<VisitorArg<F>>;
+
+// A handler with one parameter of a type an Any can hold. The others are fallbacks.
+template <class F> constexpr bool IsTypedVisitorHandler =
+    !std::is_void_v<VisitorArg<F>> && !IsBasicAny<VisitorValue<F>> && IsAnyConstructible<VisitorValue<F>>;
+
+// The result of a visit is the result of the first typed handler, or of the fallback.
+template <class A, class V, class... Fs> struct VisitorResult_ { using Result = std::invoke_result_t<V &, A &>; };
+template <class A, class V, class F, class... Fs> struct VisitorResult_<A, V, F, Fs...> :
+    std::conditional_t<IsTypedVisitorHandler<F>, VisitorHandler_<F>, VisitorResult_<A, V, Fs...>> {};
+
+template <class A, class V, class... Fs>
+struct AnyVisitor
+{
+    using B = std::remove_const_t<A>;
+    using Result = typename VisitorResult_<A, V, Fs...>::Result;
+
+    static constexpr bool HasFallback = (!IsTypedVisitorHandler<Fs> || ...);
+
+    static_assert(std::is_void_v<Result> || HasFallback, "a visitor that returns a value needs a fallback handler");
+
+    ANY_ALWAYS_INLINE
+    static Result visit(A &a, V &v) {
+        B &b = const_cast<B &>(a);
+        size_t index = index_of<Fs...>(b, false);
+        if (index == sizeof...(Fs) && b.has_value()) {
+            index = index_of<Fs...>(b, true);
+        }
+        return call<0, Fs...>(index, b, a, v);
+    }
+
+private:
+    template <class F>
+    ANY_ALWAYS_INLINE
+    static bool matches(const B &b) {
+        if constexpr (IsTypedVisitorHandler<F>) {
+            return b.actions == &B::template Traits<VisitorValue<F>>::actions;
+        }
+        else {
+            return false;
+        }
+    }
+
+    template <class F>
+    ANY_ALWAYS_INLINE
+    static bool matches_typeid(const B &b) {
+        if constexpr (IsTypedVisitorHandler<F>) {
 #if ANY_USE(TYPEINFO)
-        &typeid(U)
+            return *static_cast<const std::type_info *>(b.actions->type) == typeid(VisitorValue<F>);
 #else
-        fallback_typeid<U>()
+            return b.actions->type == fallback_typeid<VisitorValue<F>>();
 #endif
-        );
-        return (std::is_function<V>{}) ? nullptr : static_cast<T *>(p);
+        }
+        else {
+            return false;
+        }
     }
-    return nullptr;
+
+    template <class F, class... Rest>
+    ANY_ALWAYS_INLINE
+    static size_t index_of(const B &b, bool slow) {
+        if ((slow ? matches_typeid<F>(b) : matches<F>(b))) {
+            return 0;
+        }
+        if constexpr (sizeof...(Rest) > 0) {
+            return 1 + index_of<Rest...>(b, slow);
+        }
+        else {
+            return 1;
+        }
+    }
+
+    template <size_t I, class F, class... Rest>
+    ANY_ALWAYS_INLINE
+    static Result call(size_t index, B &b, A &a, V &v) {
+        if constexpr (IsTypedVisitorHandler<F>) {
+            if (index == I) {
+                using U = std::conditional_t<std::is_const_v<A>, const VisitorValue<F>, VisitorValue<F>>;
+                using H = std::conditional_t<std::is_const_v<V>, const F, F>;
+                void *p = (b.actions->flags & AnyFlags::Inline) ? static_cast<void *>(&b.storage.buf) : b.storage.ptr;
+                return static_cast<H &>(v)(static_cast<VisitorArg<F>>(*static_cast<U *>(p)));
+            }
+        }
+        if constexpr (sizeof...(Rest) > 0) {
+            return call<I + 1, Rest...>(index, b, a, v);
+        }
+        else if constexpr (HasFallback) {
+            return v(a);
+        }
+    }
+};
+
+template <class V> struct VisitorHandlers_ {
+    template <class A, class W> using Visitor = AnyVisitor<A, W, V>;
+};
+template <class... Fs> struct VisitorHandlers_<overloaded<Fs...>> {
+    template <class A, class W> using Visitor = AnyVisitor<A, W, Fs...>;
+};
+
+template <class Visitor, size_t Size, size_t Align, class Hot>
+ANY_ALWAYS_INLINE
+decltype(auto) visit(BasicAny<Size, Align, Hot> &a, Visitor &&v) {
+    using V = std::remove_reference_t<Visitor>;
+    using A = BasicAny<Size, Align, Hot>;
+    return VisitorHandlers_<std::remove_const_t<V>>::template Visitor<A, V>::visit(a, v);
+}
+
+template <class Visitor, size_t Size, size_t Align, class Hot>
+ANY_ALWAYS_INLINE
+decltype(auto) visit(const BasicAny<Size, Align, Hot> &a, Visitor &&v) {
+    using V = std::remove_reference_t<Visitor>;
+    using A = const BasicAny<Size, Align, Hot>;
+    return VisitorHandlers_<std::remove_const_t<V>>::template Visitor<A, V>::visit(a, v);
 }
 
 }  // namespace Cyto
+
+#endif  // CYTO_ANY
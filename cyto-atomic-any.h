@@ -0,0 +1,262 @@
+//
+// cyto-atomic-any.h
+//
+// An Any that readers can load while a writer replaces it, with epoch-based reclamation.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef CYTO_ATOMIC_ANY
+#define CYTO_ATOMIC_ANY 1
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+
+#include "cyto-any.h"
+
+namespace Cyto {
+
+//
+// The epochs that protect values read from an AtomicAny. A thread reading an AtomicAny
+// records the global epoch in its own Reader while it reads, and clears it when it's
+// done. A writer that replaces a value advances the global epoch, and frees the old
+// value once no reader is still in an epoch from before the replacement. Readers never
+// wait or retry, so reads are wait-free, though the first read in each thread takes a
+// lock to find it a Reader.
+//
+// Readers are never freed. When a thread exits, its Reader is marked unused, and the
+// next thread to need one takes it over. Reads a thread makes after that, from the
+// destructors of its other thread_local values, use a second Reader, which is never
+// given back, so it can't be shared with a thread that took over the first.
+//
+class AtomicAnyEpochs
+{
+public:
+    struct alignas(CacheLineSize) Reader
+    {
+        std::atomic<uint64_t> epoch = 0;
+        std::atomic<bool> in_use = true;
+        Reader *next = nullptr;
+    };
+
+    ANY_ALWAYS_INLINE
+    static Reader &reader() {
+        Reader *r = current_reader;
+        if (__builtin_expect(r == nullptr, 0)) {
+            r = reader_without_local();
+        }
+        return *r;
+    }
+
+    ANY_ALWAYS_INLINE
+    static uint64_t current() {
+        return epoch.load(std::memory_order_seq_cst);
+    }
+
+    // Advance the global epoch, and return the new one.
+    static uint64_t advance() {
+        return epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    }
+
+    // The oldest epoch a reader is in, or the largest epoch if no reader is reading.
+    static uint64_t oldest() {
+        uint64_t e = std::numeric_limits<uint64_t>::max();
+        for (Reader *r = readers.load(std::memory_order_acquire); r != nullptr; r = r->next) {
+            uint64_t x = r->epoch.load(std::memory_order_seq_cst);
+            if (x != 0 && x < e) {
+                e = x;
+            }
+        }
+        return e;
+    }
+
+private:
+    struct LocalReader
+    {
+        ~LocalReader() {
+            current_reader = nullptr;
+            exited = true;
+            if (reader != nullptr) {
+                reader->in_use.store(false, std::memory_order_release);
+            }
+        }
+
+        Reader *reader;
+    };
+
+    // Called on a thread's first read, and for reads made after the thread has released
+    // its Reader during thread exit, which use a Reader that stays in use for good.
+    static Reader *reader_without_local() {
+        if (!exited) {
+            return local.reader = current_reader = acquire_reader();
+        }
+        if (exit_reader == nullptr) {
+            exit_reader = acquire_reader();
+        }
+        return exit_reader;
+    }
+
+    static Reader *acquire_reader() {
+        std::lock_guard<std::mutex> guard(readers_lock);
+        for (Reader *r = readers.load(std::memory_order_relaxed); r != nullptr; r = r->next) {
+            if (!r->in_use.load(std::memory_order_acquire)) {
+                r->in_use.store(true, std::memory_order_relaxed);
+                return r;
+            }
+        }
+        Reader *r = new Reader;
+        r->next = readers.load(std::memory_order_relaxed);
+        readers.store(r, std::memory_order_release);
+        return r;
+    }
+
+    static inline std::atomic<uint64_t> epoch = 1;
+    static inline std::atomic<Reader *> readers = nullptr;
+    static inline std::mutex readers_lock;
+    static inline thread_local Reader *current_reader = nullptr;
+    static inline thread_local Reader *exit_reader = nullptr;
+    static inline thread_local bool exited = false;
+    static inline thread_local LocalReader local;
+};
+
+//
+// BasicAtomicAny holds a value of Any type A that any number of threads can read while
+// other threads replace it. Each value lives in its own heap node, which is never
+// changed once published. Readers either copy the value out with load(), or look at it
+// in place with read(), which calls a function with a reference to the value and
+// copies nothing. Writers replace the node with store() or exchange(), and free the
+// nodes they replace once the readers that might see them are done. Writers take a
+// lock among themselves, but never block readers.
+//
+template <class A>
+class BasicAtomicAny
+{
+public:
+    BasicAtomicAny() : node(heap_make<Node>()) {}
+
+    explicit BasicAtomicAny(A value) : node(heap_make<Node>(std::move(value))) {}
+
+    BasicAtomicAny(const BasicAtomicAny &) = delete;
+    BasicAtomicAny &operator=(const BasicAtomicAny &) = delete;
+
+    // There must be no readers or writers left when this is destroyed.
+    ~BasicAtomicAny() {
+        heap_drop(node.load(std::memory_order_relaxed));
+        reclaim(std::numeric_limits<uint64_t>::max());
+    }
+
+    A load() const {
+        return read([](const A &value) { return value; });
+    }
+
+    // Call f with a reference to the current value, which stays valid until f returns,
+    // even if a writer replaces it in the meantime, and return what f returns. Calls to
+    // read() can nest.
+    template <class F>
+    decltype(auto) read(F &&f) const {
+        AtomicAnyEpochs::Reader &r = AtomicAnyEpochs::reader();
+        bool outer = r.epoch.load(std::memory_order_relaxed) == 0;
+        if (outer) {
+            r.epoch.store(AtomicAnyEpochs::current(), std::memory_order_seq_cst);
+        }
+        ReadGuard guard{r, outer};
+        const Node *n = node.load(std::memory_order_seq_cst);
+        return std::forward<F>(f)(static_cast<const A &>(n->value));
+    }
+
+    void store(A value) {
+        replace(heap_make<Node>(std::move(value)));
+    }
+
+    // Store value, and return a copy of the value it replaced.
+    A exchange(A value) {
+        return replace(heap_make<Node>(std::move(value)), true);
+    }
+
+private:
+    struct Node
+    {
+        template <class... Args>
+        Node(Args &&... args) : value(std::forward<Args>(args)...) {}
+
+        A value;
+        Node *next_retired = nullptr;
+        uint64_t retired_epoch = 0;
+    };
+
+    struct ReadGuard
+    {
+        ~ReadGuard() {
+            if (outer) {
+                reader.epoch.store(0, std::memory_order_release);
+            }
+        }
+
+        AtomicAnyEpochs::Reader &reader;
+        bool outer;
+    };
+
+    // Publish n, retire the node it replaces, and free the retired nodes no reader can
+    // still see. The old node is retired before its value is copied, so it's freed
+    // later even if the copy throws, and it can't be freed during the copy, since
+    // reclaiming only happens here, under the writer lock, after the copy. Readers
+    // might be reading the old value while it's copied, which is fine, since nobody
+    // changes it.
+    A replace(Node *n, bool copy_old = false) {
+        std::lock_guard<std::mutex> guard(writer_lock);
+        Node *old = node.exchange(n, std::memory_order_seq_cst);
+        old->retired_epoch = AtomicAnyEpochs::advance();
+        old->next_retired = retired;
+        retired = old;
+        A result = copy_old ? old->value : A();
+        reclaim(AtomicAnyEpochs::oldest());
+        return result;
+    }
+
+    // Free the retired nodes that were retired in epochs no later than the oldest one
+    // a reader is still in, since every such reader started after they were replaced.
+    void reclaim(uint64_t oldest) {
+        Node **link = &retired;
+        while (Node *n = *link) {
+            if (n->retired_epoch <= oldest) {
+                *link = n->next_retired;
+                heap_drop(n);
+            }
+            else {
+                link = &n->next_retired;
+            }
+        }
+    }
+
+    std::atomic<Node *> node;
+    std::mutex writer_lock;
+    Node *retired = nullptr;
+};
+
+using AtomicAny = BasicAtomicAny<Any>;
+
+}  // namespace Cyto
+
+#endif  // CYTO_ATOMIC_ANY
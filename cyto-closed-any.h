@@ -0,0 +1,361 @@
+//
+// cyto-closed-any.h
+//
+// An Any over a closed set of types, with compile-time dispatch in place of actions.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef CYTO_CLOSED_ANY
+#define CYTO_CLOSED_ANY 1
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <tuple>
+#include <utility>
+
+#include "cyto-any.h"
+
+namespace Cyto {
+
+//
+// The index of T in Ts, or sizeof...(Ts) if T isn't one of them.
+//
+template <class T, class... Ts>
+constexpr size_t closed_any_index() {
+    constexpr bool matches[] = { std::is_same_v<T, Ts>..., false };
+    size_t i = 0;
+    while (i < sizeof...(Ts) && !matches[i]) {
+        i++;
+    }
+    return i;
+}
+
+template <class... Ts>
+class ClosedAny;
+
+template <class V, class... Ts>
+using IsClosedAnyConstructible_ =
+    std::bool_constant<!IsInPlaceType<V> &&
+        closed_any_index<std::decay_t<V>, Ts...>() < sizeof...(Ts)>;
+
+template <class V, class... Ts> constexpr bool IsClosedAnyConstructible = IsClosedAnyConstructible_<V, Ts...>::value;
+
+//
+// ClosedAny has the API of Any for values whose types are all in Ts. Every value is
+// stored inline, in a buffer sized for the largest of Ts, next to a small index that
+// says which of Ts it holds, with zero meaning empty. Copies, moves, and drops switch
+// on the index instead of calling through an actions table, so the compiler can see
+// and inline all of them, and any_cast is an integer compare. When all of Ts are
+// trivially copyable, relocatable, or destructible, the corresponding operations are
+// done on the raw bytes with no switch at all.
+//
+template <class... Ts>
+class ClosedAny
+{
+public:
+    static_assert(sizeof...(Ts) > 0, "ClosedAny needs at least one type");
+    static_assert(((std::is_same_v<Ts, std::decay_t<Ts>> && std::is_copy_constructible_v<Ts>) && ...),
+        "ClosedAny types must be decayed and copy constructible");
+
+    using IndexType = std::conditional_t<sizeof...(Ts) < 255, uint8_t, uint16_t>;
+
+    static constexpr size_t BufferSize = std::max({ sizeof(Ts)... });
+    static constexpr size_t BufferAlignment = std::max({ alignof(Ts)... });
+
+    // The index of T, plus one, or zero if T isn't one of Ts.
+    template <class T> static constexpr IndexType IndexOf =
+        closed_any_index<T, Ts...>() < sizeof...(Ts) ? closed_any_index<T, Ts...>() + 1 : 0;
+
+    static constexpr bool IsTriviallyCopyable = (std::is_trivially_copyable_v<Ts> && ...);
+    static constexpr bool IsTriviallyRelocatable = (is_trivially_relocatable_v<Ts> && ...);
+    static constexpr bool IsTriviallyDestructible = (std::is_trivially_destructible_v<Ts> && ...);
+    static constexpr bool IsNothrowRelocatable = (std::is_nothrow_move_constructible_v<Ts> && ...);
+
+    ClosedAny() noexcept {}
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsClosedAnyConstructible<V, Ts...>, int> = 0>
+    ClosedAny(V &&v) {
+        make<T>(std::forward<V>(v));
+    }
+
+    template <class V, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<std::is_constructible_v<T, Args...> && IsClosedAnyConstructible<T, Ts...>, int> = 0>
+    explicit ClosedAny(std::in_place_type_t<V> vtype, Args &&... args) {
+        make<T>(std::forward<Args>(args)...);
+    }
+
+    template <class V, class U, class ...Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...> &&
+            IsClosedAnyConstructible<T, Ts...>, int> = 0>
+    explicit ClosedAny(std::in_place_type_t<V> vtype, std::initializer_list<U> list, Args &&... args) {
+        make<T>(list, std::forward<Args>(args)...);
+    }
+
+    ClosedAny(const ClosedAny &other) {
+        copy_storage(other);
+    }
+
+    ClosedAny(ClosedAny &&other) noexcept(IsNothrowRelocatable) {
+        relocate_storage(other);
+    }
+
+    ClosedAny &operator=(const ClosedAny &other) {
+        if (this != &other) {
+            reset();
+            copy_storage(other);
+        }
+        return *this;
+    }
+
+    ClosedAny &operator=(ClosedAny &&other) noexcept(IsNothrowRelocatable) {
+        if (this != &other) {
+            reset();
+            relocate_storage(other);
+        }
+        return *this;
+    }
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsClosedAnyConstructible<V, Ts...>, int> = 0>
+    ClosedAny &operator=(V &&v) {
+        *this = ClosedAny(std::forward<V>(v));
+        return *this;
+    }
+
+    ~ClosedAny() {
+        drop_storage();
+    }
+
+    template <class V, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<std::is_constructible_v<T, Args...> && IsClosedAnyConstructible<T, Ts...>, int> = 0>
+    T &emplace(Args &&... args) {
+        reset();
+        return make<T>(std::forward<Args>(args)...);
+    }
+
+    template <class V, class U, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...> &&
+            IsClosedAnyConstructible<T, Ts...>, int> = 0>
+    T &emplace(std::initializer_list<U> list, Args &&... args) {
+        reset();
+        return make<T>(list, std::forward<Args>(args)...);
+    }
+
+    ANY_ALWAYS_INLINE
+    void reset() noexcept {
+        drop_storage();
+        index = 0;
+    }
+
+    void swap(ClosedAny &rhs) noexcept(IsNothrowRelocatable) {
+        if (this == &rhs) {
+            return;
+        }
+
+        if constexpr (IsTriviallyRelocatable) {
+            std::swap(buf, rhs.buf);
+            std::swap(index, rhs.index);
+        }
+        else {
+            ClosedAny tmp(std::move(rhs));
+            rhs.relocate_storage(*this);
+            relocate_storage(tmp);
+        }
+    }
+
+    template <bool B>
+    ANY_ALWAYS_INLINE
+    bool has_value() const noexcept { return (index != 0) == B; }
+
+    ANY_ALWAYS_INLINE
+    bool has_value() const noexcept { return has_value<true>(); }
+
+#if ANY_USE(TYPEINFO)
+    const std::type_info &type() const noexcept {
+        static constexpr const std::type_info *types[] = { &typeid(void), &typeid(Ts)... };
+        return *types[index];
+    }
+#endif
+
+    template <class V, class... Xs>
+    friend std::remove_cv_t<std::remove_reference_t<V>> *any_cast(ClosedAny<Xs...> *a) noexcept;
+
+private:
+    template <class T>
+    ANY_ALWAYS_INLINE
+    T *ptr() noexcept {
+        return std::launder(reinterpret_cast<T *>(buf));
+    }
+
+    template <class T>
+    ANY_ALWAYS_INLINE
+    const T *ptr() const noexcept {
+        return std::launder(reinterpret_cast<const T *>(buf));
+    }
+
+    // Construct a T in the buffer, which must not hold a value. The index is only set
+    // once the value has been made, so if making it throws, the ClosedAny is empty.
+    template <class T, class... Args>
+    ANY_ALWAYS_INLINE
+    T &make(Args &&... args) {
+        T *t = ::new (static_cast<void *>(buf)) T(std::forward<Args>(args)...);
+        index = IndexOf<T>;
+        return *t;
+    }
+
+    // Call f with std::integral_constant<size_t, I> for the value of type Ts[I], or
+    // not at all if empty. The chain of compares folds into a switch.
+    template <class F, size_t... I>
+    ANY_ALWAYS_INLINE
+    void dispatch(F &&f, std::index_sequence<I...>) const {
+        ((index == I + 1 ? (f(std::integral_constant<size_t, I>()), true) : false) || ...);
+    }
+
+    template <class F>
+    ANY_ALWAYS_INLINE
+    void dispatch(F &&f) const {
+        dispatch(std::forward<F>(f), std::index_sequence_for<Ts...>());
+    }
+
+    template <size_t I>
+    using TypeAt = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+    ANY_ALWAYS_INLINE
+    void copy_storage(const ClosedAny &other) {
+        if constexpr (IsTriviallyCopyable) {
+            memcpy(static_cast<void *>(buf), static_cast<const void *>(other.buf), BufferSize);
+            index = other.index;
+        }
+        else {
+            other.dispatch([&](auto i) {
+                using T = TypeAt<decltype(i)::value>;
+                make<T>(*other.template ptr<T>());
+            });
+        }
+    }
+
+    // Move the value in other to this, which must be empty, and leave other empty.
+    ANY_ALWAYS_INLINE
+    void relocate_storage(ClosedAny &other) noexcept(IsNothrowRelocatable) {
+        if constexpr (IsTriviallyRelocatable) {
+            memcpy(static_cast<void *>(buf), static_cast<const void *>(other.buf), BufferSize);
+            index = other.index;
+        }
+        else {
+            other.dispatch([&](auto i) {
+                using T = TypeAt<decltype(i)::value>;
+                T *t = other.template ptr<T>();
+                make<T>(std::move(*t));
+                t->~T();
+            });
+        }
+        other.index = 0;
+    }
+
+    ANY_ALWAYS_INLINE
+    void drop_storage() noexcept {
+        if constexpr (!IsTriviallyDestructible) {
+            dispatch([&](auto i) {
+                using T = TypeAt<decltype(i)::value>;
+                ptr<T>()->~T();
+            });
+        }
+    }
+
+    alignas(BufferAlignment) unsigned char buf[BufferSize];
+    IndexType index = 0;
+};
+
+template <class... Ts>
+ANY_ALWAYS_INLINE
+void swap(ClosedAny<Ts...> &lhs, ClosedAny<Ts...> &rhs) noexcept(noexcept(lhs.swap(rhs))) {
+    lhs.swap(rhs);
+}
+
+template <class A, class T, class ...Args>
+ANY_ALWAYS_INLINE
+A make_closed_any(Args&&... args) {
+    return A(std::in_place_type<T>, std::forward<Args>(args)...);
+}
+
+template <class A, class T, class U, class ...Args>
+ANY_ALWAYS_INLINE
+A make_closed_any(std::initializer_list<U> il, Args&&... args) {
+    return A(std::in_place_type<T>, il, std::forward<Args>(args)...);
+}
+
+template <class V, class... Ts, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, const T &>{}, int> = 0>
+V any_cast(const ClosedAny<Ts...> &a) {
+    auto tmp = any_cast<std::add_const_t<T>>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(*tmp);
+}
+
+template <class V, class... Ts, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, T &>{}, int> = 0>
+V any_cast(ClosedAny<Ts...> &a) {
+    auto tmp = any_cast<T>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(*tmp);
+}
+
+template <class V, class... Ts, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, T>{}, int> = 0>
+V any_cast(ClosedAny<Ts...> &&a) {
+    auto tmp = any_cast<T>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(std::move(*tmp));
+}
+
+template <class V, class... Ts, class T = std::remove_cv_t<std::remove_reference_t<V>>>
+const T *any_cast(const ClosedAny<Ts...> *a) noexcept {
+    return any_cast<V>(const_cast<ClosedAny<Ts...> *>(a));
+}
+
+// A cast to a type outside Ts compiles, and always returns nullptr.
+template <class V, class... Ts>
+std::remove_cv_t<std::remove_reference_t<V>> *any_cast(ClosedAny<Ts...> *a) noexcept {
+    using T = std::remove_cv_t<std::remove_reference_t<V>>;
+    constexpr auto i = ClosedAny<Ts...>::template IndexOf<std::decay_t<V>>;
+    if constexpr (i == 0 || std::is_function_v<V>) {
+        return nullptr;
+    }
+    else {
+        if (a && a->index == i) {
+            return a->template ptr<T>();
+        }
+        return nullptr;
+    }
+}
+
+}  // namespace Cyto
+
+#endif  // CYTO_CLOSED_ANY
@@ -0,0 +1,581 @@
+//
+// cyto-compact-any.h
+//
+// A 16-byte Any for memory-bound containers of small values.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef CYTO_COMPACT_ANY
+#define CYTO_COMPACT_ANY 1
+
+#include <atomic>
+#include <cstdint>
+
+#include "cyto-any.h"
+
+#ifndef ANY_COMPACT_REGISTRY_CAPACITY
+#define ANY_COMPACT_REGISTRY_CAPACITY 4096
+#endif
+
+namespace Cyto {
+
+//
+// The low bits of a tag index the CompactAnyRegistry, and the high bits say which
+// operations on the value can be done on the raw bytes of the storage, so copies,
+// moves, and drops of small trivial values never need to look up their actions.
+//
+struct CompactAnyTag
+{
+    // Copies are copies of the storage, and drops do nothing.
+    static constexpr uint32_t Trivial = uint32_t(1) << 31;
+    // Moves are copies of the storage.
+    static constexpr uint32_t Relocatable = uint32_t(1) << 30;
+    static constexpr uint32_t IndexMask = Relocatable - 1;
+    static constexpr uint32_t Void = Trivial | Relocatable;
+    // The empty value's index without its bits, which no value has.
+    static constexpr uint32_t Unregistered = 0;
+};
+
+//
+// The 16 bytes of a CompactAny: a 12-byte buffer, followed by a 32-bit tag that
+// identifies the type of the value. Values that don't fit in the buffer are stored
+// on the heap, and the buffer holds a pointer to them.
+//
+struct alignas(8) CompactStorage
+{
+    static constexpr size_t BufferSize = 12;
+
+    CompactStorage() {}
+    CompactStorage(const CompactStorage &) = delete;
+    CompactStorage(CompactStorage &&) = delete;
+    CompactStorage &operator=(const CompactStorage &) = delete;
+    CompactStorage &operator=(CompactStorage &&) = delete;
+
+    unsigned char buf[BufferSize];
+    uint32_t tag = CompactAnyTag::Void;
+};
+
+template <class T>
+using IsCompactStorageSized_ =
+    std::bool_constant<sizeof(T) <= CompactStorage::BufferSize &&
+        std::alignment_of_v<CompactStorage> % std::alignment_of_v<T> == 0 &&
+        std::is_nothrow_move_constructible_v<T>>;
+
+template <class T> constexpr bool IsCompactStorageSized = IsCompactStorageSized_<T>::value;
+
+struct CompactAnyActions
+{
+    using Get = void *(*)(CompactStorage *s, const void *type);
+    using Copy = void (*)(CompactStorage *dst, const CompactStorage *src);
+    using Relocate = void (*)(CompactStorage *dst, CompactStorage *src);
+    using Drop = void (*)(CompactStorage *s);
+
+    constexpr CompactAnyActions() noexcept {}
+
+    constexpr CompactAnyActions(Get g, Copy c, Relocate r, Drop d, const void *t) noexcept :
+        get(g), copy(c), relocate(r), drop(d), type(t) {}
+
+    Get get = void_get<CompactStorage>;
+    Copy copy = void_copy<CompactStorage>;
+    Relocate relocate = void_relocate<CompactStorage>;
+    Drop drop = void_drop<CompactStorage>;
+#if ANY_USE(TYPEINFO)
+    const void *type = static_cast<const void *>(&typeid(void));
+#else
+    const void *type = fallback_typeid<void>();
+#endif
+};
+
+//
+// The actions of every type stored in a CompactAny get an index in this table the
+// first time the type is used. Index zero holds the actions of the empty value.
+// Registering more than Capacity types aborts, so raise ANY_COMPACT_REGISTRY_CAPACITY
+// if a program needs more.
+//
+class CompactAnyRegistry
+{
+public:
+    static constexpr size_t Capacity = ANY_COMPACT_REGISTRY_CAPACITY;
+    static_assert(Capacity <= CompactAnyTag::IndexMask, "registry capacity too large for the tag index");
+
+    static uint32_t add(const CompactAnyActions *actions) {
+        uint32_t index = count.fetch_add(1, std::memory_order_relaxed);
+        if (index >= Capacity) {
+            abort();
+        }
+        tables[index] = actions;
+        return index;
+    }
+
+    ANY_ALWAYS_INLINE
+    static const CompactAnyActions *lookup(uint32_t tag) {
+        return tables[tag & CompactAnyTag::IndexMask];
+    }
+
+private:
+    static constexpr CompactAnyActions VoidActions = CompactAnyActions();
+
+    static inline std::atomic<uint32_t> count = 1;
+    static inline const CompactAnyActions *tables[Capacity] = { &VoidActions };
+};
+
+template <class T>
+struct CompactAnyTraits
+{
+    using S = CompactStorage;
+
+    template <class X = T, class... Args,
+        std::enable_if_t<IsCompactStorageSized<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static X &make(S *s, std::in_place_type_t<X> vtype, Args &&... args) {
+        return *(::new (static_cast<void *>(s->buf)) X(std::forward<Args>(args)...));
+    }
+
+    template <class X = T, class... Args,
+        std::enable_if_t<!IsCompactStorageSized<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static X &make(S *s, std::in_place_type_t<X> vtype, Args &&... args) {
+        X *x = heap_make<X>(std::forward<Args>(args)...);
+        set_ptr(s, x);
+        return *x;
+    }
+
+    // The tag for T, registering its actions on first use.
+    ANY_ALWAYS_INLINE
+    static uint32_t tag() {
+        static const uint32_t t = add();
+        return t;
+    }
+
+    // The tag for T if it has been registered, or CompactAnyTag::Unregistered if not, so
+    // looking for a T that was never stored doesn't use up a registry slot.
+    ANY_ALWAYS_INLINE
+    static uint32_t registered_tag() {
+        return registered.load(std::memory_order_relaxed);
+    }
+
+    ANY_ALWAYS_INLINE
+    static void *ptr(const S *s) {
+        void *p;
+        memcpy(static_cast<void *>(&p), static_cast<const void *>(s->buf), sizeof(void *));
+        return p;
+    }
+
+private:
+    CompactAnyTraits(const CompactAnyTraits &) = default;
+    CompactAnyTraits(CompactAnyTraits &&) = default;
+    CompactAnyTraits &operator=(const CompactAnyTraits &) = default;
+    CompactAnyTraits &operator=(CompactAnyTraits &&) = default;
+
+    static uint32_t add() {
+        uint32_t t = CompactAnyRegistry::add(&actions) | bits;
+        registered.store(t, std::memory_order_relaxed);
+        return t;
+    }
+
+    ANY_ALWAYS_INLINE
+    static void set_ptr(S *s, void *p) {
+        memcpy(static_cast<void *>(s->buf), static_cast<const void *>(&p), sizeof(void *));
+    }
+
+    template <class X = T>
+    ANY_ALWAYS_INLINE
+    static bool compare_typeid(const void *id) {
+#if ANY_USE(TYPEINFO)
+        return *(static_cast<const std::type_info *>(id)) == typeid(X);
+#else
+        return (id && id == fallback_typeid<X>());
+#endif
+    }
+
+    //
+    // get
+    //
+    template <class X = T,
+        std::enable_if_t<IsCompactStorageSized<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void *get(S *s, const void *type) {
+        if (compare_typeid<X>(type)) {
+            return static_cast<void *>(s->buf);
+        }
+        return nullptr;
+    }
+
+    template <class X = T,
+        std::enable_if_t<!IsCompactStorageSized<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void *get(S *s, const void *type) {
+        if (compare_typeid<X>(type)) {
+            return ptr(s);
+        }
+        return nullptr;
+    }
+
+    //
+    // copy
+    //
+    template <class X = T,
+        std::enable_if_t<IsCompactStorageSized<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void copy(S *dst, const S *src) {
+        make(dst, std::in_place_type_t<X>(), *static_cast<const X *>(static_cast<const void *>(src->buf)));
+    }
+
+    template <class X = T,
+        std::enable_if_t<!IsCompactStorageSized<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void copy(S *dst, const S *src) {
+        make(dst, std::in_place_type_t<X>(), *static_cast<const X *>(ptr(src)));
+    }
+
+    //
+    // relocate
+    //
+    template <class X = T,
+        std::enable_if_t<IsCompactStorageSized<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void relocate(S *dst, S *src) {
+        X &t = *static_cast<X *>(static_cast<void *>(src->buf));
+        ::new (static_cast<void *>(dst->buf)) X(std::move(t));
+        t.~X();
+    }
+
+    template <class X = T,
+        std::enable_if_t<!IsCompactStorageSized<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void relocate(S *dst, S *src) {
+        set_ptr(dst, ptr(src));
+    }
+
+    //
+    // drop
+    //
+    template <class X = T,
+        std::enable_if_t<IsCompactStorageSized<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void drop(S *s) {
+        static_cast<X *>(static_cast<void *>(s->buf))->~X();
+    }
+
+    template <class X = T,
+        std::enable_if_t<!IsCompactStorageSized<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void drop(S *s) {
+        heap_drop(static_cast<X *>(ptr(s)));
+    }
+
+    static constexpr uint32_t bits =
+        (IsCompactStorageSized<T> && std::is_trivially_copyable_v<T> ? CompactAnyTag::Trivial : 0) |
+        (!IsCompactStorageSized<T> || is_trivially_relocatable_v<T> ? CompactAnyTag::Relocatable : 0);
+
+    static inline std::atomic<uint32_t> registered = CompactAnyTag::Unregistered;
+
+public:
+    static constexpr CompactAnyActions actions = CompactAnyActions(get<T>, copy<T>, relocate<T>, drop<T>,
+#if ANY_USE(TYPEINFO)
+        &typeid(T)
+#else
+        fallback_typeid<T>()
+#endif
+    );
+};
+
+class CompactAny;
+
+template <class V, class T = std::decay_t<V>>
+using IsCompactAnyConstructible_ =
+    std::bool_constant<!std::is_same_v<T, CompactAny> && !IsInPlaceType<V> &&
+        std::is_copy_constructible_v<T>>;
+
+template <class V> constexpr bool IsCompactAnyConstructible = IsCompactAnyConstructible_<V>::value;
+
+//
+// CompactAny has the API of Any in half the space: 16 bytes instead of 32. Values of
+// up to 12 bytes are stored inline, which covers the scalars that make up most
+// columns of values, and arrays of them fit twice as many per cache line. The price
+// is an extra load from CompactAnyRegistry to find the actions for non-trivial values.
+//
+class CompactAny
+{
+public:
+    using StorageType = CompactStorage;
+    template <class T> using Traits = CompactAnyTraits<T>;
+
+    template <class T> static constexpr bool IsInline = IsCompactStorageSized<T>;
+
+    CompactAny() noexcept {}
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsCompactAnyConstructible<V>, int> = 0>
+    CompactAny(V &&v) {
+        Traits<T>::make(&storage, std::in_place_type_t<T>(), std::forward<V>(v));
+        storage.tag = Traits<T>::tag();
+    }
+
+    template <class V, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<std::is_constructible_v<T, Args...> && IsCompactAnyConstructible<T>, int> = 0>
+    explicit CompactAny(std::in_place_type_t<V> vtype, Args &&... args) {
+        Traits<T>::make(&storage, vtype, std::forward<Args>(args)...);
+        storage.tag = Traits<T>::tag();
+    }
+
+    template <class V, class U, class ...Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...>, int> = 0>
+    explicit CompactAny(std::in_place_type_t<V> vtype, std::initializer_list<U> list, Args &&... args) {
+        Traits<T>::make(&storage, vtype, list, std::forward<Args>(args)...);
+        storage.tag = Traits<T>::tag();
+    }
+
+    CompactAny(const CompactAny &other) {
+        copy_storage(other);
+    }
+
+    CompactAny(CompactAny &&other) noexcept {
+        relocate_storage(other);
+    }
+
+    CompactAny &operator=(const CompactAny &other) {
+        if (this != &other) {
+            reset();
+            copy_storage(other);
+        }
+        return *this;
+    }
+
+    CompactAny &operator=(CompactAny &&other) noexcept {
+        if (this != &other) {
+            drop_storage();
+            relocate_storage(other);
+        }
+        return *this;
+    }
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsCompactAnyConstructible<V>, int> = 0>
+    CompactAny &operator=(V &&v) {
+        *this = CompactAny(std::forward<V>(v));
+        return *this;
+    }
+
+    ~CompactAny() {
+        drop_storage();
+    }
+
+    template <class V, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<std::is_constructible_v<T, Args...> && std::is_copy_constructible_v<T>, int> = 0>
+    T &emplace(Args &&... args) {
+        reset();
+        T &t = Traits<T>::make(&storage, std::in_place_type_t<T>(), std::forward<Args>(args)...);
+        storage.tag = Traits<T>::tag();
+        return t;
+    }
+
+    template <class V, class U, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...>, int> = 0>
+    T &emplace(std::initializer_list<U> list, Args &&... args) {
+        reset();
+        T &t = Traits<T>::make(&storage, std::in_place_type_t<T>(), list, std::forward<Args>(args)...);
+        storage.tag = Traits<T>::tag();
+        return t;
+    }
+
+    ANY_ALWAYS_INLINE
+    void reset() {
+        drop_storage();
+        storage.tag = CompactAnyTag::Void;
+    }
+
+    ANY_ALWAYS_INLINE
+    void swap(CompactAny &rhs) noexcept {
+        if (this == &rhs) {
+            return;
+        }
+
+        if (storage.tag & rhs.storage.tag & CompactAnyTag::Relocatable) {
+            alignas(StorageType) unsigned char tmp[sizeof(StorageType)];
+            memcpy(static_cast<void *>(tmp), static_cast<const void *>(&rhs.storage), sizeof(StorageType));
+            memcpy(static_cast<void *>(&rhs.storage), static_cast<const void *>(&storage), sizeof(StorageType));
+            memcpy(static_cast<void *>(&storage), static_cast<const void *>(tmp), sizeof(StorageType));
+            return;
+        }
+
+        CompactAny tmp(std::move(rhs));
+        rhs.relocate_storage(*this);
+        relocate_storage(tmp);
+    }
+
+    template <bool B>
+    ANY_ALWAYS_INLINE
+    bool has_value() const noexcept { return ((storage.tag & CompactAnyTag::IndexMask) != 0) == B; }
+
+    ANY_ALWAYS_INLINE
+    bool has_value() const noexcept { return has_value<true>(); }
+
+#if ANY_USE(TYPEINFO)
+    const std::type_info &type() const noexcept {
+        return *static_cast<const std::type_info *>(CompactAnyRegistry::lookup(storage.tag)->type);
+    }
+#endif
+
+    template <class V>
+    friend std::remove_cv_t<std::remove_reference_t<V>> *any_cast(CompactAny *a) noexcept;
+
+private:
+    // Copy, move, and drop the value held by other or this, copying the storage bytes
+    // when the tag says that's all there is to it, and calling through the registered
+    // actions otherwise. Moves leave other empty.
+    ANY_ALWAYS_INLINE
+    void copy_storage(const CompactAny &other) {
+        uint32_t tag = other.storage.tag;
+        if (tag & CompactAnyTag::Trivial) {
+            memcpy(static_cast<void *>(&storage), static_cast<const void *>(&other.storage), sizeof(StorageType));
+        }
+        else {
+            CompactAnyRegistry::lookup(tag)->copy(&storage, &other.storage);
+            storage.tag = tag;
+        }
+    }
+
+    ANY_ALWAYS_INLINE
+    void relocate_storage(CompactAny &other) noexcept {
+        uint32_t tag = other.storage.tag;
+        if (tag & CompactAnyTag::Relocatable) {
+            memcpy(static_cast<void *>(&storage), static_cast<const void *>(&other.storage), sizeof(StorageType));
+        }
+        else {
+            CompactAnyRegistry::lookup(tag)->relocate(&storage, &other.storage);
+            storage.tag = tag;
+        }
+        other.storage.tag = CompactAnyTag::Void;
+    }
+
+    ANY_ALWAYS_INLINE
+    void drop_storage() noexcept {
+        uint32_t tag = storage.tag;
+        if (!(tag & CompactAnyTag::Trivial)) {
+            CompactAnyRegistry::lookup(tag)->drop(&storage);
+        }
+    }
+
+    // See BasicAny::get(). A type registered from more than one shared library has
+    // more than one tag, so fall back to comparing type ids before giving up. Looking
+    // for a type doesn't register it, since registering can abort.
+    template <class U, std::enable_if_t<IsCompactAnyConstructible<U>, int> = 0>
+    ANY_ALWAYS_INLINE
+    void *get() noexcept {
+        if (storage.tag == Traits<U>::registered_tag()) {
+            return IsInline<U> ? static_cast<void *>(storage.buf) : Traits<U>::ptr(&storage);
+        }
+        return get_slow<U>();
+    }
+
+    template <class U, std::enable_if_t<!IsCompactAnyConstructible<U>, int> = 0>
+    ANY_ALWAYS_INLINE
+    void *get() noexcept {
+        return nullptr;
+    }
+
+    template <class U>
+    void *get_slow() noexcept {
+        if (has_value<false>()) {
+            return nullptr;
+        }
+        return CompactAnyRegistry::lookup(storage.tag)->get(&storage,
+#if ANY_USE(TYPEINFO)
+        &typeid(U)
+#else
+        fallback_typeid<U>()
+#endif
+        );
+    }
+
+    StorageType storage;
+};
+
+static_assert(sizeof(CompactAny) == 16, "CompactAny should be 16 bytes");
+
+ANY_ALWAYS_INLINE
+void swap(CompactAny &lhs, CompactAny &rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+template <class T, class ...Args>
+ANY_ALWAYS_INLINE
+CompactAny make_compact_any(Args&&... args) {
+    return CompactAny(std::in_place_type<T>, std::forward<Args>(args)...);
+}
+
+template <class T, class U, class ...Args>
+ANY_ALWAYS_INLINE
+CompactAny make_compact_any(std::initializer_list<U> il, Args&&... args) {
+    return CompactAny(std::in_place_type<T>, il, std::forward<Args>(args)...);
+}
+
+template <class V, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, const T &>{}, int> = 0>
+V any_cast(const CompactAny &a) {
+    auto tmp = any_cast<std::add_const_t<T>>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(*tmp);
+}
+
+template <class V, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, T &>{}, int> = 0>
+V any_cast(CompactAny &a) {
+    auto tmp = any_cast<T>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(*tmp);
+}
+
+template <class V, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, T>{}, int> = 0>
+V any_cast(CompactAny &&a) {
+    auto tmp = any_cast<T>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(std::move(*tmp));
+}
+
+template <class V, class T = std::remove_cv_t<std::remove_reference_t<V>>>
+const T *any_cast(const CompactAny *a) noexcept {
+    return any_cast<V>(const_cast<CompactAny *>(a));
+}
+
+template <class V>
+std::remove_cv_t<std::remove_reference_t<V>> *any_cast(CompactAny *a) noexcept {
+    using T = std::remove_cv_t<std::remove_reference_t<V>>;
+    using U = std::decay_t<V>;
+    if (a) {
+        void *p = a->template get<U>();
+        return (std::is_function<V>{}) ? nullptr : static_cast<T *>(p);
+    }
+    return nullptr;
+}
+
+}  // namespace Cyto
+
+#endif  // CYTO_COMPACT_ANY
@@ -0,0 +1,271 @@
+//
+// cyto-lazy-any.h
+//
+// An Any that makes its value on first access, from a factory it stores inline.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef CYTO_LAZY_ANY
+#define CYTO_LAZY_ANY 1
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "cyto-any.h"
+
+namespace Cyto {
+
+// Factories that make the value of a LazyAny in its slot, which holds the factory
+// until then. Each one moves itself out of the slot before making the value, since
+// making the value replaces it.
+template <class T, class... Args>
+struct LazyAnyConstruct
+{
+    template <class A>
+    static void make(A &slot) {
+        LazyAnyConstruct f = std::move(*any_cast<LazyAnyConstruct>(&slot));
+        std::apply([&slot](Args &... args) { slot.template emplace<T>(std::move(args)...); }, f.args);
+    }
+
+    std::tuple<Args...> args;
+};
+
+template <class T, class F>
+struct LazyAnyInvoke
+{
+    template <class A>
+    static void make(A &slot) {
+        LazyAnyInvoke f = std::move(*any_cast<LazyAnyInvoke>(&slot));
+        slot.template emplace<T>(f.f());
+    }
+
+    F f;
+};
+
+struct deferred_t { explicit deferred_t() = default; };
+inline constexpr deferred_t deferred{};
+
+//
+// BasicLazyAny holds a factory for a value until the value is first asked for, with
+// value() or any_cast, and then makes the value in place of the factory. A factory
+// that fits in the inline buffer of A, like the arguments of a constructor that
+// allocates, costs no allocation until it runs. If making the value throws, the
+// BasicLazyAny is left empty.
+//
+// With Synchronized set, threads can ask for the value at the same time, and the first
+// one makes it while the others wait. Copying one makes its value first, so the copy
+// never races with it. Without Synchronized, copies copy the factory.
+//
+template <class A, bool Synchronized = false>
+class BasicLazyAny
+{
+public:
+    BasicLazyAny() noexcept {}
+
+    template <class V, class T = std::decay_t<V>, 
+        std::enable_if_t<!std::is_same_v<T, BasicLazyAny> && !IsInPlaceType<T> && std::is_constructible_v<A, V &&>, int> = 0>
+    BasicLazyAny(V &&v) : slot(std::forward<V>(v)) {}
+
+    // Defer making a T from args, which are copied or moved into the factory.
+    template <class V, class... Args, class T = std::decay_t<V>>
+    explicit BasicLazyAny(std::in_place_type_t<V>, Args &&... args) : 
+        slot(LazyAnyConstruct<T, std::decay_t<Args>...>{ { std::forward<Args>(args)... } }),
+        make(LazyAnyConstruct<T, std::decay_t<Args>...>::template make<A>), state(Pending) {}
+
+    // Defer calling f, and hold what it returns.
+    template <class F, class T = std::decay_t<std::invoke_result_t<std::decay_t<F> &>>>
+    BasicLazyAny(deferred_t, F &&f) :
+        slot(LazyAnyInvoke<T, std::decay_t<F>>{ std::forward<F>(f) }),
+        make(LazyAnyInvoke<T, std::decay_t<F>>::template make<A>), state(Pending) {}
+
+    BasicLazyAny(const BasicLazyAny &other) : slot(other.copy_source()), make(other.make), state(other.load_state()) {}
+
+    BasicLazyAny(BasicLazyAny &&other) noexcept :
+        slot(std::move(other.slot)), make(other.make), state(other.load_state()) {
+        other.make = nullptr;
+        other.set_state(Ready);
+    }
+
+    BasicLazyAny &operator=(const BasicLazyAny &other) {
+        if (this != &other) {
+            *this = BasicLazyAny(other);
+        }
+        return *this;
+    }
+
+    BasicLazyAny &operator=(BasicLazyAny &&other) noexcept {
+        if (this != &other) {
+            slot = std::move(other.slot);
+            make = other.make;
+            set_state(other.load_state());
+            other.make = nullptr;
+            other.set_state(Ready);
+        }
+        return *this;
+    }
+
+    // True if the value has been made, or is waiting to be made.
+    bool has_value() const noexcept { return load_state() != Ready || slot.has_value(); }
+
+    bool is_pending() const noexcept { return load_state() == Pending; }
+
+    void reset() noexcept {
+        slot.reset();
+        make = nullptr;
+        set_state(Ready);
+    }
+
+    ANY_ALWAYS_INLINE
+    A &value() {
+        if (__builtin_expect(load_state() != Ready, 0)) {
+            materialize();
+        }
+        return slot;
+    }
+
+    ANY_ALWAYS_INLINE
+    const A &value() const {
+        if (__builtin_expect(load_state() != Ready, 0)) {
+            materialize();
+        }
+        return slot;
+    }
+
+private:
+    enum : uint8_t { Ready, Pending, Busy };
+
+    using Make = void (*)(A &slot);
+    using State = std::conditional_t<Synchronized, std::atomic<uint8_t>, uint8_t>;
+
+    uint8_t load_state() const noexcept {
+        if constexpr (Synchronized) {
+            return state.load(std::memory_order_acquire);
+        }
+        else {
+            return state;
+        }
+    }
+
+    // For changes made while no other thread is looking, like moves.
+    void set_state(uint8_t s) const noexcept {
+        if constexpr (Synchronized) {
+            state.store(s, std::memory_order_relaxed);
+        }
+        else {
+            state = s;
+        }
+    }
+
+    const A &copy_source() const {
+        if constexpr (Synchronized) {
+            return value();
+        }
+        else {
+            return slot;
+        }
+    }
+
+    void materialize() const {
+        if constexpr (Synchronized) {
+            uint8_t pending = Pending;
+            if (!state.compare_exchange_strong(pending, Busy, std::memory_order_acquire)) {
+                while (state.load(std::memory_order_acquire) != Ready) {
+                    std::this_thread::yield();
+                }
+                return;
+            }
+        }
+        Make m = make;
+        make = nullptr;
+#if ANY_USE(EXCEPTIONS)
+        try {
+            m(slot);
+        }
+        catch (...) {
+            slot.reset();
+            publish();
+            throw;
+        }
+#else
+        m(slot);
+#endif
+        publish();
+    }
+
+    void publish() const {
+        if constexpr (Synchronized) {
+            state.store(Ready, std::memory_order_release);
+        }
+        else {
+            state = Ready;
+        }
+    }
+
+    // Making the value of a const BasicLazyAny changes these.
+    mutable A slot;
+    mutable Make make = nullptr;
+    mutable State state = Ready;
+};
+
+using LazyAny = BasicLazyAny<Any>;
+using SyncLazyAny = BasicLazyAny<Any, true>;
+
+template <class T, class... Args>
+LazyAny make_lazy_any(Args &&... args) {
+    return LazyAny(std::in_place_type<T>, std::forward<Args>(args)...);
+}
+
+// Defer calling f until the value is asked for, and hold what it returns.
+template <class F>
+LazyAny defer_any(F &&f) {
+    return LazyAny(deferred, std::forward<F>(f));
+}
+
+template <class V, class A, bool Synchronized>
+auto any_cast(BasicLazyAny<A, Synchronized> *a) {
+    return a ? any_cast<V>(&a->value()) : nullptr;
+}
+
+template <class V, class A, bool Synchronized>
+auto any_cast(const BasicLazyAny<A, Synchronized> *a) {
+    return a ? any_cast<V>(&a->value()) : nullptr;
+}
+
+template <class V, class A, bool Synchronized>
+V any_cast(BasicLazyAny<A, Synchronized> &a) {
+    return any_cast<V>(a.value());
+}
+
+template <class V, class A, bool Synchronized>
+V any_cast(const BasicLazyAny<A, Synchronized> &a) {
+    return any_cast<V>(a.value());
+}
+
+}  // namespace Cyto
+
+#endif  // CYTO_LAZY_ANY
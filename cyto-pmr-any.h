@@ -0,0 +1,442 @@
+//
+// cyto-pmr-any.h
+//
+// An allocator-aware Any that places large values in a std::pmr::memory_resource.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CYTO_PMR_ANY
+#define CYTO_PMR_ANY 1
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+#include "cyto-any.h"
+
+namespace Cyto {
+
+template <class S>
+ANY_ALWAYS_INLINE
+static constexpr void pmr_void_copy(S *dst, const S *src, std::pmr::memory_resource *r) {}
+
+template <class S>
+ANY_ALWAYS_INLINE
+static constexpr void pmr_void_drop(S *s, std::pmr::memory_resource *r) {}
+
+//
+// Like AnyActions, but the copy and drop actions are passed the memory resource
+// of the PmrAny that owns the storage. Get and relocate never allocate, so they
+// have the same signatures as their AnyActions counterparts.
+//
+template <class S>
+struct PmrAnyActions
+{
+    using Get = void *(*)(S *s, const void *type);
+    using Copy = void (*)(S *dst, const S *src, std::pmr::memory_resource *r);
+    using Relocate = void (*)(S *dst, S *src);
+    using Drop = void (*)(S *s, std::pmr::memory_resource *r);
+
+    constexpr PmrAnyActions() noexcept {}
+
+    constexpr PmrAnyActions(Get g, Copy c, Relocate r, Drop d, const void *t) noexcept :
+        get(g), copy(c), relocate(r), drop(d), type(t) {}
+
+    Get get = void_get<S>;
+    Copy copy = pmr_void_copy<S>;
+    Relocate relocate = void_relocate<S>;
+    Drop drop = pmr_void_drop<S>;
+#if ANY_USE(TYPEINFO)
+    const void *type = static_cast<const void *>(&typeid(void));
+#else
+    const void *type = fallback_typeid<void>();
+#endif
+};
+
+//
+// Small values take the same code paths as they do in AnyTraits, so those actions
+// are borrowed from AnyTraits. Large values are allocated from the memory resource.
+//
+template <class T, class S>
+struct PmrAnyTraits
+{
+    template <class X = T, class... Args,
+        std::enable_if_t<IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static X &make(S *s, std::pmr::memory_resource *r, std::in_place_type_t<X> vtype, Args &&... args) {
+        return AnyTraits<X, S>::make(s, vtype, std::forward<Args>(args)...);
+    }
+
+    template <class X = T, class... Args,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static X &make(S *s, std::pmr::memory_resource *r, std::in_place_type_t<X> vtype, Args &&... args) {
+        // Give the block back to the resource if the constructor throws.
+        auto release = [r](void *p) { r->deallocate(p, sizeof(X), alignof(X)); };
+        std::unique_ptr<void, decltype(release)> block(r->allocate(sizeof(X), alignof(X)), release);
+        X *x = ::new (block.get()) X(std::forward<Args>(args)...);
+        s->ptr = block.release();
+        return *x;
+    }
+
+private:
+    PmrAnyTraits(const PmrAnyTraits &) = default;
+    PmrAnyTraits(PmrAnyTraits &&) = default;
+    PmrAnyTraits &operator=(const PmrAnyTraits &) = default;
+    PmrAnyTraits &operator=(PmrAnyTraits &&) = default;
+
+    //
+    // copy
+    //
+    template <class X = T,
+        std::enable_if_t<std::is_same_v<X, void>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void copy(S *dst, const S *src, std::pmr::memory_resource *r) {}
+
+    template <class X = T,
+        std::enable_if_t<IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void copy(S *dst, const S *src, std::pmr::memory_resource *r) {
+        AnyTraits<X, S>::actions.copy(dst, src);
+    }
+
+    template <class X = T,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void copy(S *dst, const S *src, std::pmr::memory_resource *r) {
+        PmrAnyTraits::make(dst, r, std::in_place_type_t<X>(), *static_cast<X const *>(static_cast<void const *>(src->ptr)));
+    }
+
+    //
+    // drop
+    //
+    template <class X = T,
+        std::enable_if_t<std::is_same_v<X, void>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void drop(S *s, std::pmr::memory_resource *r) {}
+
+    template <class X = T,
+        std::enable_if_t<IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void drop(S *s, std::pmr::memory_resource *r) {
+        AnyTraits<X, S>::actions.drop(s);
+    }
+
+    template <class X = T,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void drop(S *s, std::pmr::memory_resource *r) {
+        static_cast<X *>(s->ptr)->~X();
+        r->deallocate(s->ptr, sizeof(X), alignof(X));
+    }
+
+public:
+    static constexpr PmrAnyActions<S> actions = PmrAnyActions<S>(
+        AnyTraits<T, S>::actions.get, copy<T>, AnyTraits<T, S>::actions.relocate, drop<T>,
+        AnyTraits<T, S>::actions.type);
+};
+
+template <size_t Size, size_t Align = StorageBufferAlignment> class BasicPmrAny;
+
+using PmrAny = BasicPmrAny<StorageBufferSize>;
+
+template <class T>  struct IsBasicPmrAny_ : std::false_type {};
+template <size_t Size, size_t Align> struct IsBasicPmrAny_<BasicPmrAny<Size, Align>> : std::true_type {};
+template <class T>  constexpr bool IsBasicPmrAny = IsBasicPmrAny_<T>::value;
+
+template <class V, class T = std::decay_t<V>>
+using IsPmrAnyConstructible_ =
+    std::bool_constant<!IsBasicPmrAny<T> && IsAnyConstructible<V>>;
+
+template <class V> constexpr bool IsPmrAnyConstructible = IsPmrAnyConstructible_<V>::value;
+
+//
+// BasicPmrAny remembers the memory resource it was constructed with and uses it
+// for values too large for the inline storage buffer. The resource travels with
+// the value: copies and moves, including assignments, adopt the resource of the
+// source. Converting assignment and emplace use the resource already in place.
+// Use the allocator-extended copy and move constructors to put a value into
+// a different resource.
+//
+template <size_t Size, size_t Align>
+class BasicPmrAny
+{
+public:
+    using StorageType = Storage<Size, Align>;
+    using Actions = PmrAnyActions<StorageType>;
+    template <class T> using Traits = PmrAnyTraits<T, StorageType>;
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    BasicPmrAny() noexcept : BasicPmrAny(std::allocator_arg, allocator_type()) {}
+
+    BasicPmrAny(std::allocator_arg_t, const allocator_type &alloc) noexcept :
+        actions(VoidAnyActions), resource(alloc.resource()) {}
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsPmrAnyConstructible<V>, int> = 0>
+    BasicPmrAny(V &&v) : BasicPmrAny(std::allocator_arg, allocator_type(), std::forward<V>(v)) {}
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsPmrAnyConstructible<V>, int> = 0>
+    BasicPmrAny(std::allocator_arg_t, const allocator_type &alloc, V &&v) :
+        actions(VoidAnyActions), resource(alloc.resource()) {
+        Traits<T>::make(&storage, resource, std::in_place_type_t<T>(), std::forward<V>(v));
+        actions = &Traits<T>::actions;
+    }
+
+    template <class V, class... Args, class T = std::decay_t<V>, std::enable_if_t<IsPmrAnyConstructible<T>, int> = 0>
+    explicit BasicPmrAny(std::in_place_type_t<V> vtype, Args &&... args) :
+        BasicPmrAny(std::allocator_arg, allocator_type(), vtype, std::forward<Args>(args)...) {}
+
+    template <class V, class... Args, class T = std::decay_t<V>, std::enable_if_t<IsPmrAnyConstructible<T>, int> = 0>
+    BasicPmrAny(std::allocator_arg_t, const allocator_type &alloc, std::in_place_type_t<V> vtype, Args &&... args) :
+        actions(VoidAnyActions), resource(alloc.resource()) {
+        Traits<T>::make(&storage, resource, vtype, std::forward<Args>(args)...);
+        actions = &Traits<T>::actions;
+    }
+
+    template <class V, class U, class ...Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...>, int> = 0>
+    explicit BasicPmrAny(std::in_place_type_t<V> vtype, std::initializer_list<U> list, Args &&... args) :
+        BasicPmrAny(std::allocator_arg, allocator_type(), vtype, list, std::forward<Args>(args)...) {}
+
+    template <class V, class U, class ...Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...>, int> = 0>
+    BasicPmrAny(std::allocator_arg_t, const allocator_type &alloc, std::in_place_type_t<V> vtype,
+        std::initializer_list<U> list, Args &&... args) : actions(VoidAnyActions), resource(alloc.resource()) {
+        Traits<T>::make(&storage, resource, vtype, V{list, std::forward<Args>(args)...});
+        actions = &Traits<T>::actions;
+    }
+
+    BasicPmrAny(const BasicPmrAny &other) : BasicPmrAny(std::allocator_arg, other.resource, other) {}
+
+    BasicPmrAny(std::allocator_arg_t, const allocator_type &alloc, const BasicPmrAny &other) :
+        actions(VoidAnyActions), resource(alloc.resource()) {
+        other.actions->copy(&storage, &other.storage, resource);
+        actions = other.actions;
+    }
+
+    BasicPmrAny(BasicPmrAny &&other) noexcept : actions(other.actions), resource(other.resource) {
+        actions->relocate(&storage, &other.storage);
+        other.actions = VoidAnyActions;
+    }
+
+    BasicPmrAny(std::allocator_arg_t, const allocator_type &alloc, BasicPmrAny &&other) :
+        actions(VoidAnyActions), resource(alloc.resource()) {
+        if (*resource == *other.resource) {
+            other.actions->relocate(&storage, &other.storage);
+        }
+        else {
+            other.actions->copy(&storage, &other.storage, resource);
+            other.actions->drop(&other.storage, other.resource);
+        }
+        actions = other.actions;
+        other.actions = VoidAnyActions;
+    }
+
+    BasicPmrAny &operator=(const BasicPmrAny &other) {
+        if (this != &other) {
+            reset();
+            resource = other.resource;
+            other.actions->copy(&storage, &other.storage, resource);
+            actions = other.actions;
+        }
+        return *this;
+    }
+
+    BasicPmrAny &operator=(BasicPmrAny &&other) noexcept {
+        if (this != &other) {
+            actions->drop(&storage, resource);
+            actions = other.actions;
+            resource = other.resource;
+            actions->relocate(&storage, &other.storage);
+            other.actions = VoidAnyActions;
+        }
+        return *this;
+    }
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsPmrAnyConstructible<T>, int> = 0>
+    BasicPmrAny &operator=(V &&v) {
+        *this = BasicPmrAny(std::allocator_arg, resource, std::forward<V>(v));
+        return *this;
+    }
+
+    ~BasicPmrAny() {
+        actions->drop(&storage, resource);
+    }
+
+    template <class V, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<std::is_constructible_v<T, Args...> && std::is_copy_constructible_v<T>, int> = 0>
+    T &emplace(Args &&... args) {
+        reset();
+        T &t = Traits<T>::make(&storage, resource, std::in_place_type_t<T>(), std::forward<Args>(args)...);
+        actions = &Traits<T>::actions;
+        return t;
+    }
+
+    template <class V, class U, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...>, int> = 0>
+    T &emplace(std::initializer_list<U> list, Args &&... args) {
+        reset();
+        T &t = Traits<T>::make(&storage, resource, std::in_place_type_t<T>(), V{list, std::forward<Args>(args)...});
+        actions = &Traits<T>::actions;
+        return t;
+    }
+
+    ANY_ALWAYS_INLINE
+    void reset() {
+        actions->drop(&storage, resource);
+        actions = VoidAnyActions;
+    }
+
+    ANY_ALWAYS_INLINE
+    void swap(BasicPmrAny &rhs) noexcept {
+        if (this == &rhs) {
+            return;
+        }
+
+        BasicPmrAny tmp;
+
+        // swap storage
+        rhs.actions->relocate(&tmp.storage, &rhs.storage);
+        actions->relocate(&rhs.storage, &storage);
+        rhs.actions->relocate(&storage, &tmp.storage);
+
+        // swap actions and resources
+        tmp.actions = rhs.actions;
+        rhs.actions = actions;
+        actions = tmp.actions;
+        tmp.actions = VoidAnyActions;
+        std::swap(resource, rhs.resource);
+    }
+
+    template <bool B>
+    ANY_ALWAYS_INLINE
+    bool has_value() const noexcept { return (actions != VoidAnyActions) == B; }
+
+    ANY_ALWAYS_INLINE
+    bool has_value() const noexcept { return has_value<true>(); }
+
+#if ANY_USE(TYPEINFO)
+    const std::type_info &type() const noexcept {
+        return *static_cast<const std::type_info *>(actions->type);
+    }
+#endif
+
+    allocator_type get_allocator() const noexcept { return allocator_type(resource); }
+
+    template <class V, size_t S, size_t A>
+    friend std::remove_cv_t<std::remove_reference_t<V>> *any_cast(BasicPmrAny<S, A> *a) noexcept;
+
+private:
+    // See BasicAny::get().
+    template <class U, std::enable_if_t<IsPmrAnyConstructible<U>, int> = 0>
+    ANY_ALWAYS_INLINE
+    void *get() noexcept {
+        if (actions == &Traits<U>::actions) {
+            return IsStorageBufferSized<U, StorageType> ? static_cast<void *>(&storage.buf) : storage.ptr;
+        }
+        return get_slow<U>();
+    }
+
+    template <class U, std::enable_if_t<!IsPmrAnyConstructible<U>, int> = 0>
+    ANY_ALWAYS_INLINE
+    void *get() noexcept {
+        return nullptr;
+    }
+
+    template <class U>
+    void *get_slow() noexcept {
+        if (has_value<false>()) {
+            return nullptr;
+        }
+        return actions->get(&storage,
+#if ANY_USE(TYPEINFO)
+        &typeid(U)
+#else
+        fallback_typeid<U>()
+#endif
+        );
+    }
+
+    static constexpr Actions _VoidAnyActions = Actions();
+    static constexpr const Actions * const VoidAnyActions = &_VoidAnyActions;
+
+    const Actions *actions;
+    std::pmr::memory_resource *resource;
+    StorageType storage;
+};
+
+template <size_t Size, size_t Align>
+ANY_ALWAYS_INLINE
+void swap(BasicPmrAny<Size, Align> &lhs, BasicPmrAny<Size, Align> &rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+template <class V, size_t Size, size_t Align, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, const T &>{}, int> = 0>
+V any_cast(const BasicPmrAny<Size, Align> &a) {
+    auto tmp = any_cast<std::add_const_t<T>>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(*tmp);
+}
+
+template <class V, size_t Size, size_t Align, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, const T &>{}, int> = 0>
+V any_cast(BasicPmrAny<Size, Align> &a) {
+    auto tmp = any_cast<T>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(*tmp);
+}
+
+template <class V, size_t Size, size_t Align, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, const T &>{}, int> = 0>
+V any_cast(BasicPmrAny<Size, Align> &&a) {
+    auto tmp = any_cast<T>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(std::move(*tmp));
+}
+
+template <class V, size_t Size, size_t Align, class T = std::remove_cv_t<std::remove_reference_t<V>>>
+const T *any_cast(const BasicPmrAny<Size, Align> *a) noexcept {
+    return any_cast<V>(const_cast<BasicPmrAny<Size, Align> *>(a));
+}
+
+template <class V, size_t Size, size_t Align>
+std::remove_cv_t<std::remove_reference_t<V>> *any_cast(BasicPmrAny<Size, Align> *a) noexcept {
+    using T = std::remove_cv_t<std::remove_reference_t<V>>;
+    using U = std::decay_t<V>;
+    if (a) {
+        void *p = a->template get<U>();
+        return (std::is_function<V>{}) ? nullptr : static_cast<T *>(p);
+    }
+    return nullptr;
+}
+
+}  // namespace Cyto
+
+#endif  // CYTO_PMR_ANY
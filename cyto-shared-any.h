@@ -0,0 +1,528 @@
+//
+// cyto-shared-any.h
+//
+// A copy-on-write Any that shares large values between copies.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef CYTO_SHARED_ANY
+#define CYTO_SHARED_ANY 1
+
+#include <atomic>
+
+#include "cyto-any.h"
+
+namespace Cyto {
+
+//
+// Reference counts for shared heap blocks. The atomic count lets copies of a
+// SharedAny live on different threads; the plain count is for values that never
+// leave the thread that made them.
+//
+template <bool Atomic>
+class SharedAnyCount
+{
+public:
+    ANY_ALWAYS_INLINE
+    void retain() noexcept { count.fetch_add(1, std::memory_order_relaxed); }
+
+    // Returns true when the last reference is released.
+    ANY_ALWAYS_INLINE
+    bool release() noexcept { return count.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+
+    ANY_ALWAYS_INLINE
+    bool unique() const noexcept { return count.load(std::memory_order_acquire) == 1; }
+
+private:
+    std::atomic<size_t> count = 1;
+};
+
+template <>
+class SharedAnyCount<false>
+{
+public:
+    ANY_ALWAYS_INLINE
+    void retain() noexcept { count++; }
+
+    ANY_ALWAYS_INLINE
+    bool release() noexcept { return --count == 0; }
+
+    ANY_ALWAYS_INLINE
+    bool unique() const noexcept { return count == 1; }
+
+private:
+    size_t count = 1;
+};
+
+//
+// The heap block for a large value: its reference count, followed by the value.
+//
+template <class X, bool Atomic>
+struct SharedAnyBlock
+{
+    template <class... Args>
+    SharedAnyBlock(Args &&... args) : value(std::forward<Args>(args)...) {}
+
+    SharedAnyCount<Atomic> count;
+    X value;
+};
+
+template <class S>
+ANY_ALWAYS_INLINE
+static constexpr void *shared_void_unshare(S *s) { return nullptr; }
+
+//
+// AnyActions with an unshare slot, which gives the storage its own copy of a
+// shared value, and returns the address of the value.
+//
+template <class S>
+struct SharedAnyActions
+{
+    using Get = void *(*)(S *s, const void *type);
+    using Copy = void (*)(S *dst, const S *src);
+    using Relocate = void (*)(S *dst, S *src);
+    using Drop = void (*)(S *s);
+    using Unshare = void *(*)(S *s);
+
+    constexpr SharedAnyActions() noexcept {}
+
+    constexpr SharedAnyActions(Get g, Copy c, Relocate r, Drop d, Unshare u, const void *t) noexcept :
+        get(g), copy(c), relocate(r), drop(d), unshare(u), type(t) {}
+
+    Get get = void_get<S>;
+    Copy copy = void_copy<S>;
+    Relocate relocate = void_relocate<S>;
+    Drop drop = void_drop<S>;
+    Unshare unshare = shared_void_unshare<S>;
+#if ANY_USE(TYPEINFO)
+    const void *type = static_cast<const void *>(&typeid(void));
+#else
+    const void *type = fallback_typeid<void>();
+#endif
+};
+
+//
+// Small values are stored inline and copied just as AnyTraits copies them. Large
+// values live in a SharedAnyBlock, and copying one only bumps the reference count.
+// The value is cloned the first time it's accessed for writing while shared.
+//
+template <class T, class S, bool Atomic>
+struct SharedAnyTraits
+{
+    using InlineTraits = AnyTraits<T, S>;
+    using Block = SharedAnyBlock<T, Atomic>;
+
+    template <class X = T, class... Args,
+        std::enable_if_t<IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static X &make(S *s, std::in_place_type_t<X> vtype, Args &&... args) {
+        return InlineTraits::make(s, vtype, std::forward<Args>(args)...);
+    }
+
+    template <class X = T, class... Args,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static X &make(S *s, std::in_place_type_t<X> vtype, Args &&... args) {
+        Block *block = heap_make<Block>(std::forward<Args>(args)...);
+        s->ptr = block;
+        return block->value;
+    }
+
+    //
+    // unshare
+    //
+    template <class X = T,
+        std::enable_if_t<IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void *unshare(S *s) {
+        return static_cast<void *>(&s->buf);
+    }
+
+    template <class X = T,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void *unshare(S *s) {
+        Block *block = static_cast<Block *>(s->ptr);
+        if (!block->count.unique()) {
+            Block *clone = heap_make<Block>(static_cast<const X &>(block->value));
+            drop<X>(s);
+            s->ptr = block = clone;
+        }
+        return static_cast<void *>(&block->value);
+    }
+
+private:
+    SharedAnyTraits(const SharedAnyTraits &) = default;
+    SharedAnyTraits(SharedAnyTraits &&) = default;
+    SharedAnyTraits &operator=(const SharedAnyTraits &) = default;
+    SharedAnyTraits &operator=(SharedAnyTraits &&) = default;
+
+    template <class X = T>
+    ANY_ALWAYS_INLINE
+    static bool compare_typeid(const void *id) {
+#if ANY_USE(TYPEINFO)
+        return *(static_cast<const std::type_info *>(id)) == typeid(X);
+#else
+        return (id && id == fallback_typeid<X>());
+#endif
+    }
+
+    //
+    // get
+    //
+    template <class X = T,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void *get(S *s, const void *type) {
+        if (compare_typeid<X>(type)) {
+            return static_cast<void *>(&static_cast<Block *>(s->ptr)->value);
+        }
+        return nullptr;
+    }
+
+    //
+    // copy
+    //
+    template <class X = T,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void copy(S *dst, const S *src) {
+        Block *block = static_cast<Block *>(src->ptr);
+        block->count.retain();
+        dst->ptr = block;
+    }
+
+    //
+    // drop
+    //
+    template <class X = T,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void drop(S *s) {
+        Block *block = static_cast<Block *>(s->ptr);
+        if (block->count.release()) {
+            heap_drop(block);
+        }
+    }
+
+    template <class X = T,
+        std::enable_if_t<IsStorageBufferSized<X, S>, int> = 0>
+    static constexpr SharedAnyActions<S> make_actions() {
+        return SharedAnyActions<S>(InlineTraits::actions.get, InlineTraits::actions.copy, InlineTraits::actions.relocate,
+            InlineTraits::actions.drop, unshare<X>, InlineTraits::actions.type);
+    }
+
+    template <class X = T,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    static constexpr SharedAnyActions<S> make_actions() {
+        return SharedAnyActions<S>(get<X>, copy<X>, InlineTraits::actions.relocate, drop<X>, unshare<X>, 
+            InlineTraits::actions.type);
+    }
+
+public:
+    static constexpr SharedAnyActions<S> actions = make_actions();
+};
+
+template <size_t Size, size_t Align = StorageBufferAlignment, bool Atomic = true> class BasicSharedAny;
+
+using SharedAny = BasicSharedAny<StorageBufferSize>;
+using LocalSharedAny = BasicSharedAny<StorageBufferSize, StorageBufferAlignment, false>;
+
+template <class T>  struct IsBasicSharedAny_ : std::false_type {};
+template <size_t Size, size_t Align, bool Atomic>
+struct IsBasicSharedAny_<BasicSharedAny<Size, Align, Atomic>> : std::true_type {};
+template <class T>  constexpr bool IsBasicSharedAny = IsBasicSharedAny_<T>::value;
+
+template <class V, class T = std::decay_t<V>>
+using IsSharedAnyConstructible_ =
+    std::bool_constant<!IsBasicSharedAny<T> && !IsInPlaceType<V> &&
+        std::is_copy_constructible_v<T>>;
+
+template <class V> constexpr bool IsSharedAnyConstructible = IsSharedAnyConstructible_<V>::value;
+
+//
+// BasicSharedAny has the API of BasicAny, but copies of a large value share one heap
+// block until one of them is written to. Reading through a const BasicSharedAny never
+// clones the value; getting a non-const pointer or reference to a shared value with
+// any_cast first gives this instance its own copy. With Atomic set to false, the
+// reference count is not thread-safe, so all copies must stay on one thread.
+//
+template <size_t Size, size_t Align, bool Atomic>
+class BasicSharedAny
+{
+public:
+    using StorageType = Storage<Size, Align>;
+    using Actions = SharedAnyActions<StorageType>;
+    template <class T> using Traits = SharedAnyTraits<T, StorageType, Atomic>;
+
+    template <class T> static constexpr bool IsInline = IsStorageBufferSized<T, StorageType>;
+
+    constexpr BasicSharedAny() noexcept : actions(VoidAnyActions) {}
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsSharedAnyConstructible<V>, int> = 0>
+    BasicSharedAny(V &&v) : actions(&Traits<T>::actions) {
+        Traits<T>::make(&storage, std::in_place_type_t<T>(), std::forward<V>(v));
+    }
+
+    template <class V, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<std::is_constructible_v<T, Args...> && IsSharedAnyConstructible<T>, int> = 0>
+    explicit BasicSharedAny(std::in_place_type_t<V> vtype, Args &&... args) : actions(&Traits<T>::actions) {
+        Traits<T>::make(&storage, vtype, std::forward<Args>(args)...);
+    }
+
+    template <class V, class U, class ...Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...>, int> = 0>
+    explicit BasicSharedAny(std::in_place_type_t<V> vtype, std::initializer_list<U> list, Args &&... args) :
+        actions(&Traits<T>::actions) {
+        Traits<T>::make(&storage, vtype, list, std::forward<Args>(args)...);
+    }
+
+    BasicSharedAny(const BasicSharedAny &other) : actions(other.actions) {
+        actions->copy(&storage, &other.storage);
+    }
+
+    BasicSharedAny(BasicSharedAny &&other) noexcept : actions(other.actions) {
+        actions->relocate(&storage, &other.storage);
+        other.actions = VoidAnyActions;
+    }
+
+    BasicSharedAny &operator=(const BasicSharedAny &other) {
+        if (this != &other) {
+            *this = BasicSharedAny(other);
+        }
+        return *this;
+    }
+
+    BasicSharedAny &operator=(BasicSharedAny &&other) noexcept {
+        if (this != &other) {
+            actions->drop(&storage);
+            actions = other.actions;
+            actions->relocate(&storage, &other.storage);
+            other.actions = VoidAnyActions;
+        }
+        return *this;
+    }
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsSharedAnyConstructible<V>, int> = 0>
+    BasicSharedAny &operator=(V &&v) {
+        *this = BasicSharedAny(std::forward<V>(v));
+        return *this;
+    }
+
+    ~BasicSharedAny() {
+        actions->drop(&storage);
+    }
+
+    template <class V, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<std::is_constructible_v<T, Args...> && std::is_copy_constructible_v<T>, int> = 0>
+    T &emplace(Args &&... args) {
+        reset();
+        T &t = Traits<T>::make(&storage, std::in_place_type_t<T>(), std::forward<Args>(args)...);
+        actions = &Traits<T>::actions;
+        return t;
+    }
+
+    template <class V, class U, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...>, int> = 0>
+    T &emplace(std::initializer_list<U> list, Args &&... args) {
+        reset();
+        T &t = Traits<T>::make(&storage, std::in_place_type_t<T>(), list, std::forward<Args>(args)...);
+        actions = &Traits<T>::actions;
+        return t;
+    }
+
+    ANY_ALWAYS_INLINE
+    void reset() {
+        actions->drop(&storage);
+        actions = VoidAnyActions;
+    }
+
+    ANY_ALWAYS_INLINE
+    void swap(BasicSharedAny &rhs) noexcept {
+        if (this == &rhs) {
+            return;
+        }
+
+        BasicSharedAny tmp;
+
+        // swap storage
+        rhs.actions->relocate(&tmp.storage, &rhs.storage);
+        actions->relocate(&rhs.storage, &storage);
+        rhs.actions->relocate(&storage, &tmp.storage);
+
+        // swap actions
+        tmp.actions = rhs.actions;
+        rhs.actions = actions;
+        actions = tmp.actions;
+        tmp.actions = VoidAnyActions;
+    }
+
+    template <bool B>
+    ANY_ALWAYS_INLINE
+    bool has_value() const noexcept { return (actions != VoidAnyActions) == B; }
+
+    ANY_ALWAYS_INLINE
+    bool has_value() const noexcept { return has_value<true>(); }
+
+#if ANY_USE(TYPEINFO)
+    const std::type_info &type() const noexcept {
+        return *static_cast<const std::type_info *>(actions->type);
+    }
+#endif
+
+    template <class V, size_t S, size_t A, bool B>
+    friend const std::remove_cv_t<std::remove_reference_t<V>> *any_cast(const BasicSharedAny<S, A, B> *a) noexcept;
+
+    template <class V, size_t S, size_t A, bool B>
+    friend std::remove_cv_t<std::remove_reference_t<V>> *any_cast(BasicSharedAny<S, A, B> *a);
+
+private:
+    // See BasicAny::get(). When Mutable is true, a shared value is unshared first.
+    template <class U, bool Mutable, std::enable_if_t<IsSharedAnyConstructible<U>, int> = 0>
+    ANY_ALWAYS_INLINE
+    void *get() const {
+        StorageType *s = const_cast<StorageType *>(&storage);
+        if (actions == &Traits<U>::actions) {
+            if constexpr (IsInline<U>) {
+                return static_cast<void *>(&s->buf);
+            }
+            else if constexpr (Mutable) {
+                return Traits<U>::unshare(s);
+            }
+            else {
+                return static_cast<void *>(&static_cast<typename Traits<U>::Block *>(s->ptr)->value);
+            }
+        }
+        return get_slow<U, Mutable>();
+    }
+
+    template <class U, bool Mutable, std::enable_if_t<!IsSharedAnyConstructible<U>, int> = 0>
+    ANY_ALWAYS_INLINE
+    void *get() const {
+        return nullptr;
+    }
+
+    template <class U, bool Mutable>
+    void *get_slow() const {
+        if (has_value<false>()) {
+            return nullptr;
+        }
+        StorageType *s = const_cast<StorageType *>(&storage);
+        void *p = actions->get(s,
+#if ANY_USE(TYPEINFO)
+        &typeid(U)
+#else
+        fallback_typeid<U>()
+#endif
+        );
+        return (p && Mutable) ? actions->unshare(s) : p;
+    }
+
+    static constexpr Actions _VoidAnyActions = Actions();
+    static constexpr const Actions * const VoidAnyActions = &_VoidAnyActions;
+
+    const Actions *actions;
+    StorageType storage;
+};
+
+template <size_t Size, size_t Align, bool Atomic>
+ANY_ALWAYS_INLINE
+void swap(BasicSharedAny<Size, Align, Atomic> &lhs, BasicSharedAny<Size, Align, Atomic> &rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+template <class T, class ...Args>
+ANY_ALWAYS_INLINE
+SharedAny make_shared_any(Args&&... args) {
+    return SharedAny(std::in_place_type<T>, std::forward<Args>(args)...);
+}
+
+template <class T, class U, class ...Args>
+ANY_ALWAYS_INLINE
+SharedAny make_shared_any(std::initializer_list<U> il, Args&&... args) {
+    return SharedAny(std::in_place_type<T>, il, std::forward<Args>(args)...);
+}
+
+template <class V, size_t Size, size_t Align, bool Atomic, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, const T &>{}, int> = 0>
+V any_cast(const BasicSharedAny<Size, Align, Atomic> &a) {
+    auto tmp = any_cast<T>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(*tmp);
+}
+
+// Only a request for a non-const reference needs this instance to have its own copy
+// of the value. Other casts read the value in place, even when it's shared.
+template <class V, size_t Size, size_t Align, bool Atomic, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, T &>{}, int> = 0>
+V any_cast(BasicSharedAny<Size, Align, Atomic> &a) {
+    if constexpr (std::is_constructible_v<V, const T &>) {
+        return any_cast<V>(std::as_const(a));
+    }
+    else {
+        auto tmp = any_cast<T>(&a);
+        if (tmp == nullptr) {
+            handle_bad_any_cast();
+        }
+        return static_cast<V>(*tmp);
+    }
+}
+
+template <class V, size_t Size, size_t Align, bool Atomic, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, T>{}, int> = 0>
+V any_cast(BasicSharedAny<Size, Align, Atomic> &&a) {
+    auto tmp = any_cast<T>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(std::move(*tmp));
+}
+
+template <class V, size_t Size, size_t Align, bool Atomic>
+const std::remove_cv_t<std::remove_reference_t<V>> *any_cast(const BasicSharedAny<Size, Align, Atomic> *a) noexcept {
+    using T = std::remove_cv_t<std::remove_reference_t<V>>;
+    using U = std::decay_t<V>;
+    if (a) {
+        void *p = a->template get<U, false>();
+        return (std::is_function<V>{}) ? nullptr : static_cast<const T *>(p);
+    }
+    return nullptr;
+}
+
+template <class V, size_t Size, size_t Align, bool Atomic>
+std::remove_cv_t<std::remove_reference_t<V>> *any_cast(BasicSharedAny<Size, Align, Atomic> *a) {
+    using T = std::remove_cv_t<std::remove_reference_t<V>>;
+    using U = std::decay_t<V>;
+    if (a) {
+        void *p = a->template get<U, true>();
+        return (std::is_function<V>{}) ? nullptr : static_cast<T *>(p);
+    }
+    return nullptr;
+}
+
+}  // namespace Cyto
+
+#endif  // CYTO_SHARED_ANY
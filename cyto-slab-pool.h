@@ -0,0 +1,204 @@
+//
+// cyto-slab-pool.h
+//
+// A thread-local, size-class-segregated block allocator for heap-stored Any values.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CYTO_SLAB_POOL
+#define CYTO_SLAB_POOL 1
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+namespace Cyto {
+
+//
+// SlabPool hands out blocks in multiples of BlockAlignment bytes, up to MaxBlockSize.
+// Each thread allocates from its own pool, so the common case takes no locks and
+// no atomic operations. Every pool carves blocks for one size class at a time out
+// of SlabSize-aligned slabs, and each slab starts with a header that names the
+// pool it belongs to. That lets deallocate() find the owner of any block with a
+// mask. Blocks freed by the owning thread go on a plain free list; blocks freed by
+// other threads are pushed onto a lock-free stack which the owner drains when its
+// own free list runs dry.
+//
+// Slabs are never returned to the system. When a thread exits, its pool goes on
+// an idle list, and the next thread to need a pool adopts it, along with any
+// blocks still out on loan from it.
+//
+class SlabPool
+{
+public:
+    static constexpr size_t SlabSize = 32 * 1024;
+    static constexpr size_t BlockAlignment = alignof(std::max_align_t);
+    static constexpr size_t MaxBlockSize = 512;
+    static constexpr size_t SizeClassCount = MaxBlockSize / BlockAlignment;
+
+    static constexpr size_t size_class(size_t size) {
+        return (size - 1) / BlockAlignment;
+    }
+
+    static constexpr size_t block_size(size_t size) {
+        return (size_class(size) + 1) * BlockAlignment;
+    }
+
+    inline static void *allocate(size_t size) {
+        Pool *pool = current;
+        if (__builtin_expect(pool == nullptr, 0)) {
+            return allocate_without_pool(size);
+        }
+        return pool->allocate(size_class(size));
+    }
+
+    inline static void deallocate(void *p, size_t size) {
+        SlabHeader *slab = reinterpret_cast<SlabHeader *>(reinterpret_cast<uintptr_t>(p) & ~(SlabSize - 1));
+        Pool *owner = slab->owner;
+        SizeClass &c = owner->classes[size_class(size)];
+        Block *block = static_cast<Block *>(p);
+        if (owner == current) {
+            block->next = c.free;
+            c.free = block;
+        }
+        else {
+            block->next = c.remote.load(std::memory_order_relaxed);
+            while (!c.remote.compare_exchange_weak(block->next, block,
+                std::memory_order_release, std::memory_order_relaxed)) {}
+        }
+    }
+
+private:
+    struct Block
+    {
+        Block *next;
+    };
+
+    struct alignas(64) SizeClass
+    {
+        Block *free = nullptr;
+        char *bump = nullptr;
+        char *end = nullptr;
+        std::atomic<Block *> remote = nullptr;
+    };
+
+    struct Pool;
+
+    struct alignas(64) SlabHeader
+    {
+        Pool *owner;
+    };
+
+    struct Pool
+    {
+        void *allocate(size_t index) {
+            SizeClass &c = classes[index];
+            if (Block *block = c.free) {
+                c.free = block->next;
+                return block;
+            }
+            if (c.remote.load(std::memory_order_relaxed) != nullptr) {
+                Block *block = c.remote.exchange(nullptr, std::memory_order_acquire);
+                c.free = block->next;
+                return block;
+            }
+            size_t size = (index + 1) * BlockAlignment;
+            if (static_cast<size_t>(c.end - c.bump) < size) {
+                char *slab = static_cast<char *>(::operator new(SlabSize, std::align_val_t(SlabSize)));
+                ::new (static_cast<void *>(slab)) SlabHeader{this};
+                c.bump = slab + sizeof(SlabHeader);
+                c.end = slab + SlabSize;
+            }
+            void *p = c.bump;
+            c.bump += size;
+            return p;
+        }
+
+        SizeClass classes[SizeClassCount];
+        Pool *next_idle = nullptr;
+    };
+
+    struct LocalPool
+    {
+        // The pool is null if the thread never allocated, but touched another thread_local
+        // that made this one be constructed along with it.
+        ~LocalPool() {
+            current = nullptr;
+            exited = true;
+            if (pool != nullptr) {
+                release_pool(pool);
+            }
+        }
+
+        Pool *pool;
+    };
+
+    static Pool *acquire_pool() {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        if (Pool *pool = idle) {
+            idle = pool->next_idle;
+            return pool;
+        }
+        return new Pool;
+    }
+
+    static void release_pool(Pool *pool) {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        pool->next_idle = idle;
+        idle = pool;
+    }
+
+    // Called on a thread's first allocation, and for allocations made after the thread's
+    // pool has been released during thread exit. Blocks allocated in the latter case are
+    // freed as remote blocks, which is always safe.
+    static void *allocate_without_pool(size_t size) {
+        if (!exited) {
+            local.pool = current = acquire_pool();
+            return current->allocate(size_class(size));
+        }
+        Pool *pool = acquire_pool();
+        void *p = pool->allocate(size_class(size));
+        release_pool(pool);
+        return p;
+    }
+
+    static inline std::mutex idle_lock;
+    static inline Pool *idle = nullptr;
+    static inline thread_local Pool *current = nullptr;
+    static inline thread_local bool exited = false;
+    static inline thread_local LocalPool local;
+};
+
+template <class T>
+using IsSlabPoolSized_ =
+    std::bool_constant<sizeof(T) <= SlabPool::MaxBlockSize &&
+        std::alignment_of_v<T> <= SlabPool::BlockAlignment>;
+
+template <class T> constexpr bool IsSlabPoolSized = IsSlabPoolSized_<T>::value;
+
+}  // namespace Cyto
+
+#endif  // CYTO_SLAB_POOL
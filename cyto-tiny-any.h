@@ -0,0 +1,582 @@
+//
+// cyto-tiny-any.h
+//
+// An 8-byte, NaN-boxed Any for doubles, int32s, bools, and pointers.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef CYTO_TINY_ANY
+#define CYTO_TINY_ANY 1
+
+#include <atomic>
+#include <cstdint>
+
+#include "cyto-any.h"
+
+namespace Cyto {
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "TinyAny assumes a little-endian target");
+static_assert(sizeof(void *) == 8, "TinyAny assumes 64-bit pointers");
+
+//
+// A TinyAny is one 64-bit word. Bit patterns below NaNSpace are doubles, stored as
+// themselves, with every NaN stored as CanonicalNaN. The rest of the patterns, the
+// negative quiet NaNs, hold a 3-bit kind and a 48-bit payload. Kind zero is left to
+// doubles, so a NaN with its sign bit set, which is what arithmetic on x86 produces,
+// still reads as a double.
+//
+struct TinyAnyTag
+{
+    static constexpr uint64_t NaNSpace = 0xFFF8000000000000;
+    static constexpr uint64_t CanonicalNaN = 0x7FF8000000000000;
+    static constexpr int KindShift = 48;
+    static constexpr uint64_t PayloadMask = (uint64_t(1) << KindShift) - 1;
+
+    static constexpr unsigned Double = 0;
+    static constexpr unsigned Empty = 1;
+    static constexpr unsigned Int32 = 2;
+    static constexpr unsigned Bool = 3;
+    static constexpr unsigned Boxed = 4;
+    static constexpr unsigned Pointer = 5;
+    static constexpr unsigned PointerKindCount = 3;
+
+    ANY_ALWAYS_INLINE
+    static constexpr uint64_t make(unsigned kind, uint64_t payload) {
+        return NaNSpace | (uint64_t(kind) << KindShift) | payload;
+    }
+
+    ANY_ALWAYS_INLINE
+    static constexpr unsigned kind(uint64_t bits) {
+        return bits < NaNSpace ? Double : unsigned(bits >> KindShift) & 7;
+    }
+};
+
+//
+// Values of other types, and pointers that can't be tagged, are boxed on the heap
+// behind a header that points to their actions.
+//
+struct TinyAnyActions;
+
+struct TinyAnyBoxHeader
+{
+    const TinyAnyActions *actions;
+};
+
+template <class X>
+struct TinyAnyBox : TinyAnyBoxHeader
+{
+    template <class... Args>
+    TinyAnyBox(const TinyAnyActions *a, Args &&... args) :
+        TinyAnyBoxHeader{a}, value(std::forward<Args>(args)...) {}
+
+    X value;
+};
+
+struct TinyAnyActions
+{
+    using Get = void *(*)(TinyAnyBoxHeader *h, const void *type);
+    using Copy = TinyAnyBoxHeader *(*)(const TinyAnyBoxHeader *h);
+    using Drop = void (*)(TinyAnyBoxHeader *h);
+
+    constexpr TinyAnyActions(Get g, Copy c, Drop d, const void *t) noexcept :
+        get(g), copy(c), drop(d), type(t) {}
+
+    Get get;
+    Copy copy;
+    Drop drop;
+    const void *type;
+};
+
+template <class T>
+ANY_ALWAYS_INLINE
+static const void *tiny_typeid() {
+#if ANY_USE(TYPEINFO)
+    return static_cast<const void *>(&typeid(T));
+#else
+    return fallback_typeid<T>();
+#endif
+}
+
+ANY_ALWAYS_INLINE
+static bool tiny_same_type(const void *a, const void *b) {
+#if ANY_USE(TYPEINFO)
+    return *static_cast<const std::type_info *>(a) == *static_cast<const std::type_info *>(b);
+#else
+    return a == b;
+#endif
+}
+
+//
+// The first PointerKindCount pointer types stored in a TinyAny each get a kind of
+// their own, and are stored inline. Pointers of later types are boxed.
+//
+class TinyAnyPointerKinds
+{
+public:
+    static unsigned add(const void *type) {
+        unsigned index = count.fetch_add(1, std::memory_order_relaxed);
+        if (index >= TinyAnyTag::PointerKindCount) {
+            return TinyAnyTag::Boxed;
+        }
+        types[index] = type;
+        return TinyAnyTag::Pointer + index;
+    }
+
+    ANY_ALWAYS_INLINE
+    static const void *type(unsigned kind) {
+        return types[kind - TinyAnyTag::Pointer];
+    }
+
+private:
+    static inline std::atomic<unsigned> count = 0;
+    static inline const void *types[TinyAnyTag::PointerKindCount] = {};
+};
+
+template <class T>
+struct TinyAnyTraits
+{
+    using Box = TinyAnyBox<T>;
+
+    static constexpr unsigned kind =
+        std::is_same_v<T, double> ? TinyAnyTag::Double :
+        std::is_same_v<T, int32_t> ? TinyAnyTag::Int32 :
+        std::is_same_v<T, bool> ? TinyAnyTag::Bool :
+        std::is_pointer_v<T> ? TinyAnyTag::Pointer :
+        TinyAnyTag::Boxed;
+
+    // The kind for pointers of type T, registering T on first use. Returns Boxed
+    // once the pointer kinds have run out.
+    ANY_ALWAYS_INLINE
+    static unsigned pointer_kind() {
+        static const unsigned k = TinyAnyPointerKinds::add(tiny_typeid<T>());
+        return k;
+    }
+
+private:
+    TinyAnyTraits(const TinyAnyTraits &) = default;
+    TinyAnyTraits(TinyAnyTraits &&) = default;
+    TinyAnyTraits &operator=(const TinyAnyTraits &) = default;
+    TinyAnyTraits &operator=(TinyAnyTraits &&) = default;
+
+    static void *get(TinyAnyBoxHeader *h, const void *type) {
+        if (tiny_same_type(type, tiny_typeid<T>())) {
+            return static_cast<void *>(&static_cast<Box *>(h)->value);
+        }
+        return nullptr;
+    }
+
+    static TinyAnyBoxHeader *copy(const TinyAnyBoxHeader *h) {
+        return heap_make<Box>(h->actions, static_cast<const Box *>(h)->value);
+    }
+
+    static void drop(TinyAnyBoxHeader *h) {
+        heap_drop(static_cast<Box *>(h));
+    }
+
+public:
+    static constexpr TinyAnyActions actions = TinyAnyActions(get, copy, drop,
+#if ANY_USE(TYPEINFO)
+        &typeid(T)
+#else
+        fallback_typeid<T>()
+#endif
+    );
+};
+
+class TinyAny;
+
+template <class V, class T = std::decay_t<V>>
+using IsTinyAnyConstructible_ =
+    std::bool_constant<!std::is_same_v<T, TinyAny> && !IsInPlaceType<V> &&
+        std::is_copy_constructible_v<T>>;
+
+template <class V> constexpr bool IsTinyAnyConstructible = IsTinyAnyConstructible_<V>::value;
+
+//
+// TinyAny has the API of Any in 8 bytes. A double, int32_t, or bool is stored in the
+// word itself, and so are pointers of the first few pointer types stored, as long as
+// they fit in 48 bits. Everything else is boxed on the heap.
+//
+// A tagged pointer isn't a T *, so it has no address to hand out: read pointers by
+// value with any_cast<T *>(a). Asking for their address with any_cast<T *>(&a) is a
+// compile-time error, and emplace returns pointers by value. Writing a NaN with its
+// sign bit and payload bits set through a double reference corrupts the TinyAny.
+//
+class TinyAny
+{
+public:
+    template <class T> using Traits = TinyAnyTraits<T>;
+
+    constexpr TinyAny() noexcept : word{TinyAnyTag::make(TinyAnyTag::Empty, 0)} {}
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsTinyAnyConstructible<V>, int> = 0>
+    TinyAny(V &&v) {
+        make<T>(std::forward<V>(v));
+    }
+
+    template <class V, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<std::is_constructible_v<T, Args...> && IsTinyAnyConstructible<T>, int> = 0>
+    explicit TinyAny(std::in_place_type_t<V> vtype, Args &&... args) {
+        make<T>(std::forward<Args>(args)...);
+    }
+
+    template <class V, class U, class ...Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...>, int> = 0>
+    explicit TinyAny(std::in_place_type_t<V> vtype, std::initializer_list<U> list, Args &&... args) {
+        make<T>(list, std::forward<Args>(args)...);
+    }
+
+    TinyAny(const TinyAny &other) : word{other.word.bits} {
+        if (TinyAnyTag::kind(word.bits) == TinyAnyTag::Boxed) {
+            TinyAnyBoxHeader *h = other.header();
+            word.bits = box_bits(h->actions->copy(h));
+        }
+    }
+
+    TinyAny(TinyAny &&other) noexcept : word{other.word.bits} {
+        other.word.bits = TinyAnyTag::make(TinyAnyTag::Empty, 0);
+    }
+
+    TinyAny &operator=(const TinyAny &other) {
+        if (this != &other) {
+            *this = TinyAny(other);
+        }
+        return *this;
+    }
+
+    TinyAny &operator=(TinyAny &&other) noexcept {
+        if (this != &other) {
+            drop();
+            word.bits = other.word.bits;
+            other.word.bits = TinyAnyTag::make(TinyAnyTag::Empty, 0);
+        }
+        return *this;
+    }
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsTinyAnyConstructible<V>, int> = 0>
+    TinyAny &operator=(V &&v) {
+        *this = TinyAny(std::forward<V>(v));
+        return *this;
+    }
+
+    ~TinyAny() {
+        drop();
+    }
+
+    template <class V, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<std::is_constructible_v<T, Args...> && std::is_copy_constructible_v<T>, int> = 0>
+    std::conditional_t<std::is_pointer_v<T>, T, T &> emplace(Args &&... args) {
+        reset();
+        T *t = make<T>(std::forward<Args>(args)...);
+        if constexpr (std::is_pointer_v<T>) {
+            return t ? *t : reinterpret_cast<T>(static_cast<uintptr_t>(word.bits & TinyAnyTag::PayloadMask));
+        }
+        else {
+            return *t;
+        }
+    }
+
+    template <class V, class U, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsAnyInitializerListConstructible<T, U, Args...>, int> = 0>
+    T &emplace(std::initializer_list<U> list, Args &&... args) {
+        reset();
+        return *make<T>(list, std::forward<Args>(args)...);
+    }
+
+    ANY_ALWAYS_INLINE
+    void reset() {
+        drop();
+        word.bits = TinyAnyTag::make(TinyAnyTag::Empty, 0);
+    }
+
+    ANY_ALWAYS_INLINE
+    void swap(TinyAny &rhs) noexcept {
+        std::swap(word.bits, rhs.word.bits);
+    }
+
+    template <bool B>
+    ANY_ALWAYS_INLINE
+    bool has_value() const noexcept { return (word.bits != TinyAnyTag::make(TinyAnyTag::Empty, 0)) == B; }
+
+    ANY_ALWAYS_INLINE
+    bool has_value() const noexcept { return has_value<true>(); }
+
+#if ANY_USE(TYPEINFO)
+    const std::type_info &type() const noexcept {
+        unsigned kind = TinyAnyTag::kind(word.bits);
+        switch (kind) {
+            case TinyAnyTag::Double:
+                return typeid(double);
+            case TinyAnyTag::Empty:
+                return typeid(void);
+            case TinyAnyTag::Int32:
+                return typeid(int32_t);
+            case TinyAnyTag::Bool:
+                return typeid(bool);
+            case TinyAnyTag::Boxed:
+                return *static_cast<const std::type_info *>(header()->actions->type);
+            default:
+                return *static_cast<const std::type_info *>(TinyAnyPointerKinds::type(kind));
+        }
+    }
+#endif
+
+    template <class V>
+    friend std::remove_cv_t<std::remove_reference_t<V>> *any_cast(TinyAny *a) noexcept;
+
+    template <class T>
+    friend bool tiny_any_pointer_cast(const TinyAny *a, T &out) noexcept;
+
+private:
+    union Word
+    {
+        uint64_t bits;
+        double d;
+        int32_t i;
+        bool b;
+    };
+
+    ANY_ALWAYS_INLINE
+    TinyAnyBoxHeader *header() const noexcept {
+        return reinterpret_cast<TinyAnyBoxHeader *>(static_cast<uintptr_t>(word.bits & TinyAnyTag::PayloadMask));
+    }
+
+    ANY_ALWAYS_INLINE
+    static uint64_t box_bits(TinyAnyBoxHeader *h) {
+        uint64_t u = reinterpret_cast<uintptr_t>(h);
+        if (u & ~TinyAnyTag::PayloadMask) {
+            abort();
+        }
+        return TinyAnyTag::make(TinyAnyTag::Boxed, u);
+    }
+
+    ANY_ALWAYS_INLINE
+    void drop() noexcept {
+        if (TinyAnyTag::kind(word.bits) == TinyAnyTag::Boxed) {
+            TinyAnyBoxHeader *h = header();
+            h->actions->drop(h);
+        }
+    }
+
+    // Store a new value, and return its address, or nullptr for a tagged pointer.
+    // The word is only written once the value has been made, so if making it throws,
+    // the TinyAny is left as it was.
+    template <class T, class... Args>
+    ANY_ALWAYS_INLINE
+    T *make(Args &&... args) {
+        if constexpr (Traits<T>::kind == TinyAnyTag::Double) {
+            double d = double(std::forward<Args>(args)...);
+            if (d != d) {
+                word.bits = TinyAnyTag::CanonicalNaN;
+            }
+            else {
+                word.d = d;
+            }
+            return &word.d;
+        }
+        else if constexpr (Traits<T>::kind == TinyAnyTag::Int32) {
+            int32_t i = int32_t(std::forward<Args>(args)...);
+            word.bits = TinyAnyTag::make(TinyAnyTag::Int32, static_cast<uint32_t>(i));
+            return &word.i;
+        }
+        else if constexpr (Traits<T>::kind == TinyAnyTag::Bool) {
+            bool b = bool(std::forward<Args>(args)...);
+            word.bits = TinyAnyTag::make(TinyAnyTag::Bool, b);
+            return &word.b;
+        }
+        else if constexpr (Traits<T>::kind == TinyAnyTag::Pointer) {
+            T p = T(std::forward<Args>(args)...);
+            uint64_t u = reinterpret_cast<uintptr_t>(p);
+            unsigned kind = Traits<T>::pointer_kind();
+            if (kind != TinyAnyTag::Boxed && (u & ~TinyAnyTag::PayloadMask) == 0) {
+                word.bits = TinyAnyTag::make(kind, u);
+                return nullptr;
+            }
+            return make_box<T>(p);
+        }
+        else {
+            return make_box<T>(std::forward<Args>(args)...);
+        }
+    }
+
+    template <class T, class... Args>
+    T *make_box(Args &&... args) {
+        auto *box = heap_make<TinyAnyBox<T>>(&Traits<T>::actions, std::forward<Args>(args)...);
+        word.bits = box_bits(box);
+        return &box->value;
+    }
+
+    // See BasicAny::get(). Pointers are handled by tiny_any_pointer_cast().
+    template <class U, std::enable_if_t<IsTinyAnyConstructible<U>, int> = 0>
+    ANY_ALWAYS_INLINE
+    void *get() noexcept {
+        unsigned kind = TinyAnyTag::kind(word.bits);
+        if constexpr (Traits<U>::kind == TinyAnyTag::Double) {
+            return kind == TinyAnyTag::Double ? static_cast<void *>(&word.d) : nullptr;
+        }
+        else if constexpr (Traits<U>::kind == TinyAnyTag::Int32) {
+            return kind == TinyAnyTag::Int32 ? static_cast<void *>(&word.i) : nullptr;
+        }
+        else if constexpr (Traits<U>::kind == TinyAnyTag::Bool) {
+            return kind == TinyAnyTag::Bool ? static_cast<void *>(&word.b) : nullptr;
+        }
+        else {
+            return kind == TinyAnyTag::Boxed ? get_boxed<U>() : nullptr;
+        }
+    }
+
+    template <class U, std::enable_if_t<!IsTinyAnyConstructible<U>, int> = 0>
+    ANY_ALWAYS_INLINE
+    void *get() noexcept {
+        return nullptr;
+    }
+
+    template <class U>
+    ANY_ALWAYS_INLINE
+    void *get_boxed() const noexcept {
+        TinyAnyBoxHeader *h = header();
+        if (h->actions == &Traits<U>::actions) {
+            return static_cast<void *>(&static_cast<TinyAnyBox<U> *>(h)->value);
+        }
+        return h->actions->get(h, tiny_typeid<U>());
+    }
+
+    Word word;
+};
+
+static_assert(sizeof(TinyAny) == 8, "TinyAny should be 8 bytes");
+
+ANY_ALWAYS_INLINE
+void swap(TinyAny &lhs, TinyAny &rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+template <class T, class ...Args>
+ANY_ALWAYS_INLINE
+TinyAny make_tiny_any(Args&&... args) {
+    return TinyAny(std::in_place_type<T>, std::forward<Args>(args)...);
+}
+
+template <class T, class U, class ...Args>
+ANY_ALWAYS_INLINE
+TinyAny make_tiny_any(std::initializer_list<U> il, Args&&... args) {
+    return TinyAny(std::in_place_type<T>, il, std::forward<Args>(args)...);
+}
+
+//
+// Reads a pointer value of type T, tagged or boxed, into out. Returns false if the
+// TinyAny doesn't hold a T.
+//
+template <class T>
+bool tiny_any_pointer_cast(const TinyAny *a, T &out) noexcept {
+    static_assert(std::is_pointer_v<T>, "tiny_any_pointer_cast reads pointer values");
+    uint64_t bits = a->word.bits;
+    unsigned kind = TinyAnyTag::kind(bits);
+    if (kind >= TinyAnyTag::Pointer) {
+        const void *type = TinyAnyPointerKinds::type(kind);
+        if (type == tiny_typeid<T>() || tiny_same_type(type, tiny_typeid<T>())) {
+            out = reinterpret_cast<T>(static_cast<uintptr_t>(bits & TinyAnyTag::PayloadMask));
+            return true;
+        }
+        return false;
+    }
+    if (kind == TinyAnyTag::Boxed) {
+        if (void *p = a->template get_boxed<T>()) {
+            out = *static_cast<T *>(p);
+            return true;
+        }
+    }
+    return false;
+}
+
+template <class V, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, const T &>{}, int> = 0>
+V any_cast(const TinyAny &a) {
+    if constexpr (std::is_pointer_v<T>) {
+        static_assert(!std::is_reference_v<V>, "pointers in a TinyAny can only be read by value");
+        T tmp;
+        if (!tiny_any_pointer_cast(&a, tmp)) {
+            handle_bad_any_cast();
+        }
+        return tmp;
+    }
+    else {
+        auto tmp = any_cast<std::add_const_t<T>>(&a);
+        if (tmp == nullptr) {
+            handle_bad_any_cast();
+        }
+        return static_cast<V>(*tmp);
+    }
+}
+
+template <class V, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, T &>{}, int> = 0>
+V any_cast(TinyAny &a) {
+    if constexpr (std::is_pointer_v<T>) {
+        return any_cast<V>(static_cast<const TinyAny &>(a));
+    }
+    else {
+        auto tmp = any_cast<T>(&a);
+        if (tmp == nullptr) {
+            handle_bad_any_cast();
+        }
+        return static_cast<V>(*tmp);
+    }
+}
+
+template <class V, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, T>{}, int> = 0>
+V any_cast(TinyAny &&a) {
+    if constexpr (std::is_pointer_v<T>) {
+        return any_cast<V>(static_cast<const TinyAny &>(a));
+    }
+    else {
+        auto tmp = any_cast<T>(&a);
+        if (tmp == nullptr) {
+            handle_bad_any_cast();
+        }
+        return static_cast<V>(std::move(*tmp));
+    }
+}
+
+template <class V, class T = std::remove_cv_t<std::remove_reference_t<V>>>
+const T *any_cast(const TinyAny *a) noexcept {
+    return any_cast<V>(const_cast<TinyAny *>(a));
+}
+
+template <class V>
+std::remove_cv_t<std::remove_reference_t<V>> *any_cast(TinyAny *a) noexcept {
+    using T = std::remove_cv_t<std::remove_reference_t<V>>;
+    using U = std::decay_t<V>;
+    static_assert(!std::is_pointer_v<T>, "pointers in a TinyAny can only be read by value");
+    if (a) {
+        void *p = a->template get<U>();
+        return (std::is_function<V>{}) ? nullptr : static_cast<T *>(p);
+    }
+    return nullptr;
+}
+
+}  // namespace Cyto
+
+#endif  // CYTO_TINY_ANY
@@ -0,0 +1,434 @@
+//
+// cyto-unique-any.h
+//
+// A move-only Any for values that can't be copied.
+//
+// MIT License
+//
+// Copyright (c) 2020 Ken Kocienda
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef CYTO_UNIQUE_ANY
+#define CYTO_UNIQUE_ANY 1
+
+#include "cyto-any.h"
+
+namespace Cyto {
+
+//
+// AnyActions without a copy slot.
+//
+template <class S>
+struct UniqueAnyActions
+{
+    using Get = void *(*)(S *s, const void *type);
+    using Relocate = void (*)(S *dst, S *src);
+    using Drop = void (*)(S *s);
+
+    constexpr UniqueAnyActions() noexcept {}
+
+    constexpr UniqueAnyActions(Get g, Relocate r, Drop d, const void *t) noexcept :
+        get(g), relocate(r), drop(d), type(t) {}
+
+    Get get = void_get<S>;
+    Relocate relocate = void_relocate<S>;
+    Drop drop = void_drop<S>;
+#if ANY_USE(TYPEINFO)
+    const void *type = static_cast<const void *>(&typeid(void));
+#else
+    const void *type = fallback_typeid<void>();
+#endif
+};
+
+//
+// Since a UniqueAny is never copied, any value that fits in the storage buffer is
+// stored there, whether or not its move constructor is declared noexcept. The
+// relocate action move-constructs the value into its new home and destroys the old one,
+// or, if the value is trivially relocatable, copies its bytes.
+//
+template <class T, class S>
+struct UniqueAnyTraits
+{
+    using Buffer = typename S::Buffer;
+
+    template <class X = T, class... Args,
+        std::enable_if_t<IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static X &make(S *s, std::in_place_type_t<X> vtype, Args &&... args) {
+        return *(::new (static_cast<void *>(&s->buf)) X(std::forward<Args>(args)...));
+    }
+
+    template <class X = T, class... Args,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static X &make(S *s, std::in_place_type_t<X> vtype, Args &&... args) {
+        X *x = heap_make<X>(std::forward<Args>(args)...);
+        s->ptr = x;
+        return *x;
+    }
+
+private:
+    UniqueAnyTraits(const UniqueAnyTraits &) = default;
+    UniqueAnyTraits(UniqueAnyTraits &&) = default;
+    UniqueAnyTraits &operator=(const UniqueAnyTraits &) = default;
+    UniqueAnyTraits &operator=(UniqueAnyTraits &&) = default;
+
+    template <class X = T>
+    ANY_ALWAYS_INLINE
+    static bool compare_typeid(const void *id) {
+#if ANY_USE(TYPEINFO)
+        return *(static_cast<const std::type_info *>(id)) == typeid(X);
+#else
+        return (id && id == fallback_typeid<X>());
+#endif
+    }
+
+    //
+    // get
+    //
+    template <class X = T,
+        std::enable_if_t<IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void *get(S *s, const void *type) {
+        if (compare_typeid<X>(type)) {
+            return static_cast<void *>(&s->buf);
+        }
+        return nullptr;
+    }
+
+    template <class X = T,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void *get(S *s, const void *type) {
+        if (compare_typeid<X>(type)) {
+            return s->ptr;
+        }
+        return nullptr;
+    }
+
+    //
+    // move
+    //
+    template <class X = T,
+        std::enable_if_t<IsStorageBufferSized<X, S> && is_trivially_relocatable_v<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void relocate(S *dst, S *src) {
+        memcpy(static_cast<void *>(&dst->buf), static_cast<void *>(&src->buf), sizeof(X));
+    }
+
+    template <class X = T,
+        std::enable_if_t<IsStorageBufferSized<X, S> && !is_trivially_relocatable_v<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void relocate(S *dst, S *src) {
+        X &t = *static_cast<X *>(static_cast<void *>(&src->buf));
+        ::new (static_cast<void *>(&dst->buf)) X(std::move(t));
+        t.~X();
+    }
+
+    template <class X = T,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void relocate(S *dst, S *src) {
+        dst->ptr = src->ptr;
+    }
+
+    //
+    // drop
+    //
+    template <class X = T,
+        std::enable_if_t<IsStorageBufferSized<X, S> && std::is_trivially_destructible_v<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void drop(S *s) {}
+
+    template <class X = T,
+        std::enable_if_t<IsStorageBufferSized<X, S> && !std::is_trivially_destructible_v<X>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void drop(S *s) {
+        X &t = *static_cast<X *>(static_cast<void *>(&s->buf));
+        t.~X();
+    }
+
+    template <class X = T,
+        std::enable_if_t<!IsStorageBufferSized<X, S>, int> = 0>
+    ANY_ALWAYS_INLINE
+    static void drop(S *s) {
+        heap_drop(static_cast<X *>(s->ptr));
+    }
+
+public:
+    static constexpr UniqueAnyActions<S> actions = UniqueAnyActions<S>(get<T>, relocate<T>, drop<T>,
+#if ANY_USE(TYPEINFO)
+        &typeid(T)
+#else
+        fallback_typeid<T>()
+#endif
+    );
+};
+
+template <size_t Size, size_t Align = StorageBufferAlignment> class BasicUniqueAny;
+
+using UniqueAny = BasicUniqueAny<StorageBufferSize>;
+
+template <class T>  struct IsBasicUniqueAny_ : std::false_type {};
+template <size_t Size, size_t Align> struct IsBasicUniqueAny_<BasicUniqueAny<Size, Align>> : std::true_type {};
+template <class T>  constexpr bool IsBasicUniqueAny = IsBasicUniqueAny_<T>::value;
+
+template <class V, class T = std::decay_t<V>>
+using IsUniqueAnyConstructible_ =
+    std::bool_constant<!IsBasicUniqueAny<T> && !IsInPlaceType<V> &&
+        std::is_constructible_v<T, V>>;
+
+template <class V> constexpr bool IsUniqueAnyConstructible = IsUniqueAnyConstructible_<V>::value;
+
+// Values made in place must still be movable, since moving a UniqueAny moves its value.
+template <class T, class... Args>
+using IsUniqueAnyEmplaceable_ =
+    std::bool_constant<std::is_constructible_v<T, Args...> && std::is_move_constructible_v<T>>;
+
+template <class T, class... Args> constexpr bool IsUniqueAnyEmplaceable = IsUniqueAnyEmplaceable_<T, Args...>::value;
+
+//
+// BasicUniqueAny has the API of BasicAny, except that it can't be copied, and in return,
+// it can hold move-only values like std::unique_ptr. Moving a BasicUniqueAny is noexcept,
+// so if the move constructor of a value stored inline does throw, std::terminate is called.
+//
+template <size_t Size, size_t Align>
+class BasicUniqueAny
+{
+public:
+    using StorageType = Storage<Size, Align>;
+    using Actions = UniqueAnyActions<StorageType>;
+    template <class T> using Traits = UniqueAnyTraits<T, StorageType>;
+
+    template <class T> static constexpr bool IsInline = IsStorageBufferSized<T, StorageType>;
+
+    constexpr BasicUniqueAny() noexcept : actions(VoidAnyActions) {}
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsUniqueAnyConstructible<V>, int> = 0>
+    BasicUniqueAny(V &&v) : actions(&Traits<T>::actions) {
+        Traits<T>::make(&storage, std::in_place_type_t<T>(), std::forward<V>(v));
+    }
+
+    template <class V, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsUniqueAnyEmplaceable<T, Args...> && !IsBasicUniqueAny<T>, int> = 0>
+    explicit BasicUniqueAny(std::in_place_type_t<V> vtype, Args &&... args) : actions(&Traits<T>::actions) {
+        Traits<T>::make(&storage, vtype, std::forward<Args>(args)...);
+    }
+
+    template <class V, class U, class ...Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsUniqueAnyEmplaceable<T, std::initializer_list<U> &, Args...>, int> = 0>
+    explicit BasicUniqueAny(std::in_place_type_t<V> vtype, std::initializer_list<U> list, Args &&... args) :
+        actions(&Traits<T>::actions) {
+        Traits<T>::make(&storage, vtype, list, std::forward<Args>(args)...);
+    }
+
+    BasicUniqueAny(const BasicUniqueAny &other) = delete;
+    BasicUniqueAny &operator=(const BasicUniqueAny &other) = delete;
+
+    BasicUniqueAny(BasicUniqueAny &&other) noexcept : actions(other.actions) {
+        actions->relocate(&storage, &other.storage);
+        other.actions = VoidAnyActions;
+    }
+
+    BasicUniqueAny &operator=(BasicUniqueAny &&other) noexcept {
+        if (this != &other) {
+            actions->drop(&storage);
+            actions = other.actions;
+            actions->relocate(&storage, &other.storage);
+            other.actions = VoidAnyActions;
+        }
+        return *this;
+    }
+
+    template <class V, class T = std::decay_t<V>, std::enable_if_t<IsUniqueAnyConstructible<V>, int> = 0>
+    BasicUniqueAny &operator=(V &&v) {
+        *this = BasicUniqueAny(std::forward<V>(v));
+        return *this;
+    }
+
+    ~BasicUniqueAny() {
+        actions->drop(&storage);
+    }
+
+    template <class V, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsUniqueAnyEmplaceable<T, Args...>, int> = 0>
+    T &emplace(Args &&... args) {
+        reset();
+        T &t = Traits<T>::make(&storage, std::in_place_type_t<T>(), std::forward<Args>(args)...);
+        actions = &Traits<T>::actions;
+        return t;
+    }
+
+    template <class V, class U, class... Args, class T = std::decay_t<V>,
+        std::enable_if_t<IsUniqueAnyEmplaceable<T, std::initializer_list<U> &, Args...>, int> = 0>
+    T &emplace(std::initializer_list<U> list, Args &&... args) {
+        reset();
+        T &t = Traits<T>::make(&storage, std::in_place_type_t<T>(), list, std::forward<Args>(args)...);
+        actions = &Traits<T>::actions;
+        return t;
+    }
+
+    ANY_ALWAYS_INLINE
+    void reset() {
+        actions->drop(&storage);
+        actions = VoidAnyActions;
+    }
+
+    ANY_ALWAYS_INLINE
+    void swap(BasicUniqueAny &rhs) noexcept {
+        if (this == &rhs) {
+            return;
+        }
+
+        BasicUniqueAny tmp;
+
+        // swap storage
+        rhs.actions->relocate(&tmp.storage, &rhs.storage);
+        actions->relocate(&rhs.storage, &storage);
+        rhs.actions->relocate(&storage, &tmp.storage);
+
+        // swap actions
+        tmp.actions = rhs.actions;
+        rhs.actions = actions;
+        actions = tmp.actions;
+        tmp.actions = VoidAnyActions;
+    }
+
+    template <bool B>
+    ANY_ALWAYS_INLINE
+    bool has_value() const noexcept { return (actions != VoidAnyActions) == B; }
+
+    ANY_ALWAYS_INLINE
+    bool has_value() const noexcept { return has_value<true>(); }
+
+#if ANY_USE(TYPEINFO)
+    const std::type_info &type() const noexcept {
+        return *static_cast<const std::type_info *>(actions->type);
+    }
+#endif
+
+    template <class V, size_t S, size_t A>
+    friend std::remove_cv_t<std::remove_reference_t<V>> *any_cast(BasicUniqueAny<S, A> *a) noexcept;
+
+private:
+    // See BasicAny::get().
+    template <class U, std::enable_if_t<IsUniqueAnyConstructible<U>, int> = 0>
+    ANY_ALWAYS_INLINE
+    void *get() noexcept {
+        if (actions == &Traits<U>::actions) {
+            return IsStorageBufferSized<U, StorageType> ? static_cast<void *>(&storage.buf) : storage.ptr;
+        }
+        return get_slow<U>();
+    }
+
+    template <class U, std::enable_if_t<!IsUniqueAnyConstructible<U>, int> = 0>
+    ANY_ALWAYS_INLINE
+    void *get() noexcept {
+        return nullptr;
+    }
+
+    template <class U>
+    void *get_slow() noexcept {
+        if (has_value<false>()) {
+            return nullptr;
+        }
+        return actions->get(&storage,
+#if ANY_USE(TYPEINFO)
+        &typeid(U)
+#else
+        fallback_typeid<U>()
+#endif
+        );
+    }
+
+    static constexpr Actions _VoidAnyActions = Actions();
+    static constexpr const Actions * const VoidAnyActions = &_VoidAnyActions;
+
+    const Actions *actions;
+    StorageType storage;
+};
+
+template <size_t Size, size_t Align>
+ANY_ALWAYS_INLINE
+void swap(BasicUniqueAny<Size, Align> &lhs, BasicUniqueAny<Size, Align> &rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+template <class T, class ...Args>
+ANY_ALWAYS_INLINE
+UniqueAny make_unique_any(Args&&... args) {
+    return UniqueAny(std::in_place_type<T>, std::forward<Args>(args)...);
+}
+
+template <class T, class U, class ...Args>
+ANY_ALWAYS_INLINE
+UniqueAny make_unique_any(std::initializer_list<U> il, Args&&... args) {
+    return UniqueAny(std::in_place_type<T>, il, std::forward<Args>(args)...);
+}
+
+template <class V, size_t Size, size_t Align, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, const T &>{}, int> = 0>
+V any_cast(const BasicUniqueAny<Size, Align> &a) {
+    auto tmp = any_cast<std::add_const_t<T>>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(*tmp);
+}
+
+template <class V, size_t Size, size_t Align, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, T &>{}, int> = 0>
+V any_cast(BasicUniqueAny<Size, Align> &a) {
+    auto tmp = any_cast<T>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(*tmp);
+}
+
+template <class V, size_t Size, size_t Align, class T = std::remove_cv_t<std::remove_reference_t<V>>,
+    std::enable_if_t<std::is_constructible<V, T>{}, int> = 0>
+V any_cast(BasicUniqueAny<Size, Align> &&a) {
+    auto tmp = any_cast<T>(&a);
+    if (tmp == nullptr) {
+        handle_bad_any_cast();
+    }
+    return static_cast<V>(std::move(*tmp));
+}
+
+template <class V, size_t Size, size_t Align, class T = std::remove_cv_t<std::remove_reference_t<V>>>
+const T *any_cast(const BasicUniqueAny<Size, Align> *a) noexcept {
+    return any_cast<V>(const_cast<BasicUniqueAny<Size, Align> *>(a));
+}
+
+template <class V, size_t Size, size_t Align>
+std::remove_cv_t<std::remove_reference_t<V>> *any_cast(BasicUniqueAny<Size, Align> *a) noexcept {
+    using T = std::remove_cv_t<std::remove_reference_t<V>>;
+    using U = std::decay_t<V>;
+    if (a) {
+        void *p = a->template get<U>();
+        return (std::is_function<V>{}) ? nullptr : static_cast<T *>(p);
+    }
+    return nullptr;
+}
+
+}  // namespace Cyto
+
+#endif  // CYTO_UNIQUE_ANY